@@ -0,0 +1,278 @@
+#include <cstdlib>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <boost/asio/io_context.hpp>
+
+#include "../canbus/AsioCanSocket.h"
+#include "../canbus/CanCapture.h"
+#include "../canbus/CanDevice.h"
+#include "../canbus/CanMessage.h"
+#include "../canbus/FastPacketTable.h"
+#include "../canbus/N2KPropertyProvider.h"
+
+//Proprietary PGNs, one single frame PGN per field type and one fast packet PGN, so nothing clashes with the database
+static constexpr uint32_t BENCH_SINGLE_FRAME_PGN = 65280;
+static constexpr uint32_t BENCH_FAST_PACKET_PGN = 130816;
+static constexpr uint8_t BENCH_FAST_PACKET_LENGTH = 100;
+
+static const char* FIELD_TYPES[] = {"uint8", "uint16", "int16", "int32", "float32", "bitfield", "string"};
+
+static N2KProperty benchField(const std::string& dataType, const unsigned int bitLength, const size_t index) {
+    N2KProperty field{};
+    field.name = "Field " + std::to_string(index);
+    field.uid = "bench." + dataType + "." + std::to_string(index);
+    field.dataType = dataType;
+    field.bitLength = bitLength;
+    field.multiplier = 0.01;
+    field.minVal = -1e12;
+    field.maxVal = 1e12;
+    return field;
+}
+
+///
+/// Registers the synthetic PGNs once. Each single frame PGN fills its 8 bytes with fields of one type, the fast packet
+/// PGN carries a mix of every numeric type.
+///
+static void registerBenchContainers() {
+    static bool registered = false;
+    if (registered) {
+        return;
+    }
+    registered = true;
+    for (size_t type = 0; type < std::size(FIELD_TYPES); type++) {
+        N2KContainer container{};
+        container.devicePropContainerKey = std::to_string(BENCH_SINGLE_FRAME_PGN + type);
+        container.name = std::string("Bench ") + FIELD_TYPES[type];
+        container.singleFrame = true;
+        const std::string dataType = FIELD_TYPES[type];
+        const unsigned int width = dataType == "uint8" || dataType == "bitfield" ? 8 :
+                                   dataType == "uint16" || dataType == "int16" ? 16 : dataType == "string" ? 64 : 32;
+        for (size_t i = 0; i < 64 / width; i++) {
+            container.fields.push_back(benchField(dataType, width, i));
+        }
+        N2KPropertyProvider::instance().addPropertyContainer(container);
+    }
+    N2KContainer fastPacket{};
+    fastPacket.devicePropContainerKey = std::to_string(BENCH_FAST_PACKET_PGN);
+    fastPacket.name = "Bench fast packet";
+    fastPacket.singleFrame = false;
+    unsigned int bits = 0;
+    for (size_t i = 0; bits + 32 <= BENCH_FAST_PACKET_LENGTH * 8u; i++) {
+        const std::string dataType = FIELD_TYPES[i % 5];
+        const unsigned int width = dataType == "uint8" ? 8 : dataType == "uint16" || dataType == "int16" ? 16 : 32;
+        fastPacket.fields.push_back(benchField(dataType, width, i));
+        bits += width;
+    }
+    N2KPropertyProvider::instance().addPropertyContainer(fastPacket);
+}
+
+static can_frame benchFrame(const uint32_t pgn, const uint8_t source) {
+    can_frame frame{};
+    frame.can_id = CAN_EFF_FLAG | 3u << 26 | pgn << 8 | source;
+    frame.can_dlc = 8;
+    for (uint8_t i = 0; i < 8; i++) {
+        frame.data[i] = static_cast<uint8_t>(0x11 * (i + 1));
+    }
+    return frame;
+}
+
+/// The frames of one fast packet message, sequence 0..7 taken from seq
+static std::vector<can_frame> benchFastPacket(const uint8_t source, const uint8_t seq) {
+    std::vector<can_frame> frames;
+    const size_t frameCount = 1 + (BENCH_FAST_PACKET_LENGTH - 6 + 6) / 7;
+    for (size_t frameNo = 0; frameNo < frameCount; frameNo++) {
+        can_frame frame = benchFrame(BENCH_FAST_PACKET_PGN, source);
+        frame.data[0] = static_cast<uint8_t>((seq & 0x07) << 5 | frameNo);
+        if (frameNo == 0) {
+            frame.data[1] = BENCH_FAST_PACKET_LENGTH;
+        }
+        frames.push_back(frame);
+    }
+    return frames;
+}
+
+static void BM_PopulateFieldData(benchmark::State& state) {
+    registerBenchContainers();
+    const uint32_t pgn = BENCH_SINGLE_FRAME_PGN + state.range(0);
+    const N2KContainer* dpc = N2KPropertyProvider::instance().getPropertyContainer(pgn);
+    can_frame raw = benchFrame(pgn, 1);
+    J1939Frame frame(raw);
+    state.SetLabel(FIELD_TYPES[state.range(0)]);
+    for (auto _ : state) {
+        CanMessage msg(dpc, 8, 0, 1, 255);
+        msg.addToMessage(0, frame);
+        msg.populateFieldData();
+        benchmark::DoNotOptimize(msg.fieldValues().data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PopulateFieldData)->DenseRange(0, std::size(FIELD_TYPES) - 1);
+
+static void BM_PopulateFieldDataFastPacket(benchmark::State& state) {
+    registerBenchContainers();
+    const N2KContainer* dpc = N2KPropertyProvider::instance().getPropertyContainer(BENCH_FAST_PACKET_PGN);
+    std::vector<uint8_t> payload(BENCH_FAST_PACKET_LENGTH, 0x5A);
+    for (auto _ : state) {
+        CanMessage msg(dpc, BENCH_FAST_PACKET_LENGTH, 0, 1, 255);
+        msg.setPayload(payload.data(), BENCH_FAST_PACKET_LENGTH);
+        msg.populateFieldData();
+        benchmark::DoNotOptimize(msg.fieldValues().data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PopulateFieldDataFastPacket);
+
+///
+/// Reassembles interleaved fast packet messages from range(0) senders at once, the way they arrive on a busy bus
+///
+static void BM_FastPacketReassembly(benchmark::State& state) {
+    const auto senders = static_cast<uint8_t>(state.range(0));
+    std::vector<std::vector<J1939Frame>> messages;
+    for (uint8_t seq = 0; seq < 8; seq++) {
+        for (uint8_t source = 0; source < senders; source++) {
+            std::vector<J1939Frame> frames;
+            for (can_frame& raw : benchFastPacket(source, seq)) {
+                frames.emplace_back(raw);
+            }
+            messages.push_back(std::move(frames));
+        }
+    }
+    FastPacketTable table;
+    unsigned long long now = 0;
+    size_t completed = 0;
+    for (auto _ : state) {
+        //Send frame n of every message before frame n + 1 of any of them
+        for (size_t frameNo = 0; frameNo < messages[0].size(); frameNo++) {
+            for (auto& frames : messages) {
+                if (FastPacketSession* session = table.addFrame(frames[frameNo], now)) {
+                    table.release(session);
+                    completed++;
+                }
+            }
+        }
+        now++;
+    }
+    state.SetItemsProcessed(static_cast<long long>(completed));
+}
+BENCHMARK(BM_FastPacketReassembly)->Arg(1)->Arg(4)->Arg(8);
+
+static void BM_GetPropertyContainer(benchmark::State& state) {
+    registerBenchContainers();
+    const std::vector<uint32_t> pgns = N2KPropertyProvider::instance().pgns();
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(N2KPropertyProvider::instance().getPropertyContainer(pgns[i]));
+        i = i + 1 == pgns.size() ? 0 : i + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetPropertyContainer);
+
+static void BM_GetPropertyContainerMiss(benchmark::State& state) {
+    registerBenchContainers();
+    uint32_t pgn = 1;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(N2KPropertyProvider::instance().getPropertyContainer(pgn));
+        pgn = (pgn + 2) & 0x3FF;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetPropertyContainerMiss);
+
+///
+/// range(0) distinct values per device; range(1) 0 reports an unchanged value inside its deadband, 1 a new value
+///
+static void BM_CanDeviceUpdateValue(benchmark::State& state) {
+    const auto keys = static_cast<uint32_t>(state.range(0));
+    const bool changing = state.range(1) != 0;
+    CanDevice device;
+    for (uint32_t k = 0; k < keys; k++) {
+        device.updateValue(127488 + k / 16, k % 16, 0, 1.0, 0.1, DEFAULT_HEARTBEAT_MS, 0);
+    }
+    uint32_t k = 0;
+    double value = 1.0;
+    unsigned long long now = 1;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(device.updateValue(127488 + k / 16, k % 16, 0, value, 0.1, DEFAULT_HEARTBEAT_MS, now));
+        if (++k == keys) {
+            k = 0;
+            value += changing ? 1.0 : 0.0;
+            now++;
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_CanDeviceUpdateValue)->ArgsProduct({{16, 256, 4096}, {0, 1}});
+
+static AsioCanSocket& benchSocket() {
+    //No interface, frames only arrive through injectFrame
+    static boost::asio::io_context ioCtx;
+    static AsioCanSocket socket("", ioCtx);
+    return socket;
+}
+
+///
+/// Full receive path for synthetic traffic: lookup, reassembly, decode, change detection and event dispatch
+///
+static void BM_HandleMessageSynthetic(benchmark::State& state) {
+    registerBenchContainers();
+    AsioCanSocket& socket = benchSocket();
+    std::vector<can_frame> frames;
+    for (uint8_t source = 0; source < 4; source++) {
+        for (size_t type = 0; type < std::size(FIELD_TYPES); type++) {
+            frames.push_back(benchFrame(BENCH_SINGLE_FRAME_PGN + type, source));
+        }
+        for (const can_frame& frame : benchFastPacket(source, source)) {
+            frames.push_back(frame);
+        }
+    }
+    unsigned long long timestamp = 1;
+    for (auto _ : state) {
+        for (const can_frame& frame : frames) {
+            socket.injectFrame(frame, timestamp);
+        }
+        timestamp += 1000000;
+    }
+    state.SetItemsProcessed(static_cast<long long>(state.iterations() * frames.size()));
+}
+BENCHMARK(BM_HandleMessageSynthetic);
+
+///
+/// Full receive path for a recorded capture named by SGP_BENCH_CAN_CAPTURE, candump or binary format. Needs the PGN
+/// database, so run from the build directory.
+///
+static void BM_HandleMessageRecorded(benchmark::State& state) {
+    const char* path = std::getenv("SGP_BENCH_CAN_CAPTURE");
+    if (path == nullptr) {
+        state.SkipWithError("SGP_BENCH_CAN_CAPTURE not set");
+        return;
+    }
+    static bool loaded = false;
+    if (!loaded) {
+        N2KPropertyProvider::instance().loadProperties();
+        loaded = true;
+    }
+    std::vector<std::pair<can_frame, unsigned long long>> frames;
+    CanCaptureReader reader(path);
+    can_frame frame;
+    unsigned long long timestamp;
+    while (reader.next(frame, timestamp)) {
+        frames.emplace_back(frame, timestamp);
+    }
+    if (frames.empty()) {
+        state.SkipWithError("Capture has no frames");
+        return;
+    }
+    AsioCanSocket& socket = benchSocket();
+    //Each pass is shifted past the last so reassembly never sees time run backwards
+    const unsigned long long span = frames.back().second - frames.front().second + 1000000000ULL;
+    unsigned long long offset = 0;
+    for (auto _ : state) {
+        for (const auto& [recorded, stamp] : frames) {
+            socket.injectFrame(recorded, stamp + offset);
+        }
+        offset += span;
+    }
+    state.SetItemsProcessed(static_cast<long long>(state.iterations() * frames.size()));
+}
+BENCHMARK(BM_HandleMessageRecorded)->Unit(benchmark::kMillisecond);
@@ -0,0 +1,86 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include "../event/EventDispatcher.h"
+
+//Events in flight before the producer waits for the workers, kept under the pool size so nothing is allocated
+static constexpr unsigned long long DISPATCH_BENCH_WINDOW = EVENT_POOL_SIZE / 2;
+
+class BenchListener final: public EventListener {
+public:
+    BenchListener(std::atomic<unsigned long long>& delivered, const bool serialized):
+        delivered_(delivered), serialized_(serialized) {}
+
+    void handlePropertyEvent(const NMEAPropertyEvent& ev) {
+        benchmark::DoNotOptimize(ev.deviceUid.size());
+        delivered_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool serialized() const override { return serialized_; }
+
+private:
+    std::atomic<unsigned long long>& delivered_;
+    bool serialized_;
+};
+
+static void waitForDeliveries(const std::atomic<unsigned long long>& delivered, const unsigned long long expected) {
+    while (delivered.load(std::memory_order_relaxed) < expected) {
+        std::this_thread::yield();
+    }
+}
+
+///
+/// dispatchAsync of one event to range(0) listeners, range(1) 1 for serialized listeners. Timed from the first
+/// dispatch until every listener has seen every event, so the figure is end to end delivery throughput.
+///
+static void BM_DispatchAsyncFanOut(benchmark::State& state) {
+    const auto listenerCount = static_cast<size_t>(state.range(0));
+    const bool serialized = state.range(1) != 0;
+    std::atomic<unsigned long long> delivered = 0;
+    std::vector<std::unique_ptr<BenchListener>> listeners;
+    for (size_t i = 0; i < listenerCount; i++) {
+        listeners.push_back(std::make_unique<BenchListener>(delivered, serialized));
+        EventDispatcher::instance().subscribe<&BenchListener::handlePropertyEvent>(listeners.back().get());
+    }
+    unsigned long long dispatched = 0;
+    for (auto _ : state) {
+        auto* ev = acquireEvent<NMEAPropertyEvent>();
+        ev->deviceUid = "bench";
+        ev->addValue("bench.uint16.0", "0", "12.5");
+        EventDispatcher::instance().dispatchAsync(ev);
+        if (++dispatched % DISPATCH_BENCH_WINDOW == 0) {
+            waitForDeliveries(delivered, (dispatched - DISPATCH_BENCH_WINDOW / 2) * listenerCount);
+        }
+    }
+    waitForDeliveries(delivered, dispatched * listenerCount);
+    for (const auto& listener : listeners) {
+        EventDispatcher::instance().unsubscribe(listener.get());
+    }
+    state.SetItemsProcessed(static_cast<long long>(dispatched * listenerCount));
+    state.counters["events/s"] = benchmark::Counter(static_cast<double>(dispatched), benchmark::Counter::kIsRate);
+}
+BENCHMARK(BM_DispatchAsyncFanOut)->ArgsProduct({{1, 4, 16}, {0, 1}})->UseRealTime();
+
+static void BM_DispatchDirectFanOut(benchmark::State& state) {
+    const auto listenerCount = static_cast<size_t>(state.range(0));
+    std::atomic<unsigned long long> delivered = 0;
+    std::vector<std::unique_ptr<BenchListener>> listeners;
+    for (size_t i = 0; i < listenerCount; i++) {
+        listeners.push_back(std::make_unique<BenchListener>(delivered, false));
+        EventDispatcher::instance().subscribe<&BenchListener::handlePropertyEvent>(listeners.back().get());
+    }
+    for (auto _ : state) {
+        auto* ev = acquireEvent<NMEAPropertyEvent>();
+        ev->deviceUid = "bench";
+        ev->addValue("bench.uint16.0", "0", "12.5");
+        EventDispatcher::instance().dispatchDirect(ev);
+    }
+    for (const auto& listener : listeners) {
+        EventDispatcher::instance().unsubscribe(listener.get());
+    }
+    state.SetItemsProcessed(static_cast<long long>(delivered.load()));
+}
+BENCHMARK(BM_DispatchDirectFanOut)->Arg(1)->Arg(4)->Arg(16);
@@ -0,0 +1,111 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+#include <boost/asio/io_context.hpp>
+
+#include "../gnss/GnssReader.h"
+#include "../utils/NMEAUtils.h"
+#include "../utils/UBXUtils.h"
+
+/// Wraps a sentence body in '$', checksum and CR/LF
+static std::string nmeaLine(const std::string& body) {
+    unsigned char checksum = 0;
+    for (const char c : body) {
+        checksum ^= static_cast<unsigned char>(c);
+    }
+    char suffix[6];
+    std::snprintf(suffix, sizeof(suffix), "*%02X\r\n", checksum);
+    return "$" + body + suffix;
+}
+
+static std::string navPvtFrame() {
+    std::vector<uint8_t> payload(92, 0);
+    payload[8] = 12;
+    payload[9] = 35;
+    payload[10] = 19;
+    payload[11] = 0x07;
+    payload[20] = 3;
+    payload[21] = 0x01;
+    boost::endian::store_little_s32(payload.data() + 24, -13500000);
+    boost::endian::store_little_s32(payload.data() + 28, 514500000);
+    boost::endian::store_little_s32(payload.data() + 36, 12000);
+    boost::endian::store_little_u32(payload.data() + 40, 1500);
+    boost::endian::store_little_u32(payload.data() + 44, 2500);
+    boost::endian::store_little_s32(payload.data() + 60, 5100);
+    boost::endian::store_little_s32(payload.data() + 64, 12345678);
+    const std::vector<uint8_t> frame = buildUbxFrame(UBX_CLASS_NAV, UBX_NAV_PVT, payload);
+    return {frame.begin(), frame.end()};
+}
+
+static const std::vector<std::pair<std::string, std::string>>& benchSentences() {
+    static const std::vector<std::pair<std::string, std::string>> sentences = {
+        {"GGA", nmeaLine("GNGGA,123519.00,5130.0000,N,00120.0000,W,4,12,0.9,120.0,M,47.0,M,1.2,0000")},
+        {"RMC", nmeaLine("GNRMC,123519.00,A,5130.0000,N,00120.0000,W,10.2,123.4,170926,,,R,V")},
+        {"GSA", nmeaLine("GNGSA,A,3,01,03,06,09,12,17,19,22,,,,,1.5,0.9,1.2,1")},
+        {"GSV", nmeaLine("GPGSV,3,1,12,01,40,083,46,03,12,271,38,06,55,310,44,09,20,045,40,1")},
+        {"GLL", nmeaLine("GNGLL,5130.0000,N,00120.0000,W,123519.00,A,R")},
+        {"VTG", nmeaLine("GNVTG,123.4,T,,M,10.2,N,18.9,K,R")},
+        {"UBX-NAV-PVT", navPvtFrame()},
+    };
+    return sentences;
+}
+
+static GnssReader& benchReader() {
+    //The port does not exist, so the reader never reads and only sees what feed() gives it
+    static boost::asio::io_context ioCtx;
+    static GnssReader reader(ioCtx, "");
+    return reader;
+}
+
+static void BM_ParseNmeaSentence(benchmark::State& state) {
+    std::string_view line = benchSentences()[0].second;
+    line.remove_suffix(2);
+    NmeaSentence sentence;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(parseNmeaSentence(line, sentence));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_ParseNmeaSentence);
+
+/// Framing, parsing and event dispatch for one sentence of the type named in the label
+static void BM_GnssHandlePacket(benchmark::State& state) {
+    const auto& [name, line] = benchSentences()[state.range(0)];
+    GnssReader& reader = benchReader();
+    state.SetLabel(name);
+    for (auto _ : state) {
+        reader.feed(line);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(static_cast<long long>(state.iterations() * line.size()));
+}
+BENCHMARK(BM_GnssHandlePacket)->DenseRange(0, 6);
+
+///
+/// Replays a raw receiver log named by SGP_BENCH_GNSS_LOG, NMEA and UBX mixed as they came off the serial port
+///
+static void BM_GnssRecorded(benchmark::State& state) {
+    const char* path = std::getenv("SGP_BENCH_GNSS_LOG");
+    if (path == nullptr) {
+        state.SkipWithError("SGP_BENCH_GNSS_LOG not set");
+        return;
+    }
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream contents;
+    contents << file.rdbuf();
+    const std::string log = contents.str();
+    if (log.empty()) {
+        state.SkipWithError("GNSS log is empty");
+        return;
+    }
+    GnssReader& reader = benchReader();
+    for (auto _ : state) {
+        reader.feed(log);
+    }
+    state.SetBytesProcessed(static_cast<long long>(state.iterations() * log.size()));
+}
+BENCHMARK(BM_GnssRecorded)->Unit(benchmark::kMillisecond);
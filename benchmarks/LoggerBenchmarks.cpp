@@ -0,0 +1,40 @@
+#include <string>
+#include <benchmark/benchmark.h>
+
+#include "../logging/Logger.h"
+
+///
+/// A trace line on a class logging at INFO, the case every hot path relies on being free. The message is built from a
+/// number so any evaluation of it would show up.
+///
+static void BM_LogDisabled(benchmark::State& state) {
+    int value = 0;
+    for (auto _ : state) {
+        LOG_TRACE("BenchLogger", "Value " + std::to_string(value++));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LogDisabled);
+
+static void BM_LogDisabledUnchecked(benchmark::State& state) {
+    int value = 0;
+    for (auto _ : state) {
+        Logger::instance().trace("BenchLogger", "Value " + std::to_string(value++));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LogDisabledUnchecked);
+
+///
+/// Caller side cost of an enabled line: building the message and pushing it on the queue. The writer thread prints
+/// to stdout, so run with --benchmark_out to keep the results apart. Once the writer falls behind records are dropped,
+/// which is also what the caller would see under load.
+///
+static void BM_LogEnabled(benchmark::State& state) {
+    int value = 0;
+    for (auto _ : state) {
+        LOG_INFO("BenchLogger", "Value " + std::to_string(value++));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_LogEnabled)->Threads(1)->Threads(4);
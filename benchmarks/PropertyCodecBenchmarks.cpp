@@ -0,0 +1,93 @@
+#include <charconv>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <benchmark/benchmark.h>
+
+#include "../event/PropertyCodec.h"
+#include "../influx/LineProtocol.h"
+
+static constexpr size_t CODEC_BENCH_EVENTS = 4096;
+
+///
+/// Engine and battery values from three devices as AsioCanSocket reports them: std::to_string text, slowly moving
+/// numbers and a dictionary value that rarely changes.
+///
+static std::vector<NMEAPropertyEvent> makeEvents() {
+    std::vector<NMEAPropertyEvent> events(CODEC_BENCH_EVENTS);
+    for (size_t i = 0; i < events.size(); i++) {
+        NMEAPropertyEvent& ev = events[i];
+        const std::string instance = std::to_string(i % 3);
+        ev.deviceUid = "engine-" + instance;
+        const double t = static_cast<double>(i) / 50;
+        if (i % 2 == 0) {
+            ev.addValue("127488-2", instance, std::to_string(std::round((1500 + 40 * std::sin(t)) * 4) / 4));
+            ev.addValue("127488-3", instance, std::to_string(std::round((3501 + 2 * std::sin(t / 3)) * 10) / 100));
+            ev.addValue("127488-4", instance, std::to_string(i / 400 % 3));
+        } else {
+            ev.addValue("127508-2", instance, std::to_string(std::round((12.6 + 0.05 * std::sin(t)) * 1000) / 1000));
+            ev.addValue("127508-3", instance, i / 1000 % 2 == 0 ? "Charging" : "Float");
+        }
+    }
+    return events;
+}
+
+/// The same events as the line protocol InfluxSink posts, which leaves out text values, as the size to beat
+static size_t lineProtocolBytes(const std::vector<NMEAPropertyEvent>& events) {
+    std::string out;
+    LineBuilder line(out);
+    for (const auto& ev : events) {
+        line.begin("n2k");
+        line.tag("asset", "CCM");
+        line.tag("device", ev.deviceUid);
+        line.tag("instance", ev.values().front().instance);
+        for (const auto& record : ev.values()) {
+            double value;
+            if (std::from_chars(record.value.data(), record.value.data() + record.value.size(), value).ec == std::errc{}) {
+                line.field(record.propertyUid, value);
+            }
+        }
+        line.end(1697040000123ULL);
+    }
+    return out.size();
+}
+
+static void BM_PropertyEncode(benchmark::State& state) {
+    const std::vector<NMEAPropertyEvent> events = makeEvents();
+    PropertyEncoder encoder;
+    std::string frame;
+    size_t encodedBytes = 0;
+    size_t encoded = 0;
+    for (auto _ : state) {
+        encoder.encode(events[encoded++ % events.size()], frame);
+        encodedBytes += frame.size();
+        benchmark::DoNotOptimize(frame.data());
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["bytes/event"] = static_cast<double>(encodedBytes) / static_cast<double>(encoded);
+    state.counters["text/binary"] = static_cast<double>(lineProtocolBytes(events)) * static_cast<double>(encoded) /
+                                    static_cast<double>(events.size()) / static_cast<double>(encodedBytes);
+}
+BENCHMARK(BM_PropertyEncode);
+
+static void BM_PropertyDecode(benchmark::State& state) {
+    const std::vector<NMEAPropertyEvent> events = makeEvents();
+    PropertyEncoder encoder;
+    std::vector<std::string> frames(events.size());
+    for (size_t i = 0; i < events.size(); i++) {
+        encoder.encode(events[i], frames[i]);
+    }
+    PropertyDecoder decoder;
+    NMEAPropertyEvent ev;
+    size_t decoded = 0;
+    for (auto _ : state) {
+        //The decoder has to see the frames in order, starting over from the keyframe
+        if (!decoder.decode(frames[decoded++ % frames.size()], ev)) {
+            state.SkipWithError("Frame failed to decode");
+            break;
+        }
+        benchmark::DoNotOptimize(ev.values().data());
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_PropertyDecode);
@@ -1,18 +1,47 @@
 #include "AsioCanSocket.h"
 
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <linux/net_tstamp.h>
+#include <linux/can/raw.h>
 #include "N2KPropertyProvider.h"
+#include "../config/ConfigProvider.h"
 #include "../logging/Logger.h"
 
 //TODO: Implement instance naming
 
-AsioCanSocket::AsioCanSocket(const std::string& interfaceName, boost::asio::io_context& ioCtx): stream_(ioCtx){
+AsioCanSocket::AsioCanSocket(const std::string& interfaceName, boost::asio::io_context& ioCtx): stream_(ioCtx),
+    txScheduler_(ConfigProvider::instance().canTxBudget()), txScheduleTimer_(ioCtx), txRetryTimer_(ioCtx),
+    //Bus load is a fraction of the bitrate, an unset or nonsense one would make it inf or NaN
+    bitrate_(ConfigProvider::instance().canBitrate() > 0 ? ConfigProvider::instance().canBitrate() : DEFAULT_CAN_BITRATE),
+    statsIntervalSec_(ConfigProvider::instance().canStatsInterval()),
+    statsTimer_(ioCtx){
     Logger::instance().info("AsioCanSocket", "Opening CAN socket " + interfaceName);
-    EventDispatcher::instance().subscribe(POSITION, this);
-    EventDispatcher::instance().subscribe(GNSS_SATELLITES, this);
+    EventDispatcher::instance().subscribe<&AsioCanSocket::handlePositionEvent>(this);
+    EventDispatcher::instance().subscribe<&AsioCanSocket::handleSatellitesEvent>(this);
+    lastSummary_ = stats_.snapshot();
+    scheduleStatsSummary();
+    if(interfaceName.empty()) {
+        //Nothing to read or write, frames only come in through injectFrame
+        Logger::instance().info("AsioCanSocket", "No CAN interface configured");
+        return;
+    }
+    if(const std::string& capturePath = ConfigProvider::instance().canCaptureFile(); !capturePath.empty()) {
+        const auto format = ConfigProvider::instance().canCaptureFormat() == "BINARY" ? CanCaptureFormat::BINARY : CanCaptureFormat::CANDUMP;
+        capture_ = std::make_unique<CanCaptureWriter>(capturePath, format, interfaceName);
+        if(capture_->isOpen()) {
+            Logger::instance().info("AsioCanSocket", "Capturing CAN traffic to " + capturePath);
+        } else {
+            Logger::instance().error("AsioCanSocket", "Failed to open CAN capture file " + capturePath);
+            capture_.reset();
+        }
+    }
     sockaddr_can addr{};
     ifreq ifr{};
 
     sockFd_ = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+    installReceiveFilters();
 
     strcpy(ifr.ifr_name, interfaceName.c_str());
     ioctl(sockFd_, SIOCGIFINDEX, &ifr);
@@ -24,22 +53,139 @@ AsioCanSocket::AsioCanSocket(const std::string& interfaceName, boost::asio::io_c
         return;
     }
     stream_.assign(sockFd_);
+    setupReceiveBatch();
     readOperation();
     genericISORequest(60928, 255);
 }
 
+void AsioCanSocket::setupReceiveBatch() {
+    for(size_t i = 0; i < CAN_RX_BATCH; i++) {
+        rxIov_[i].iov_base = &rxFrames_[i];
+        rxIov_[i].iov_len = sizeof(can_frame);
+        rxMsgs_[i].msg_hdr.msg_iov = &rxIov_[i];
+        rxMsgs_[i].msg_hdr.msg_iovlen = 1;
+        rxMsgs_[i].msg_hdr.msg_control = rxControl_[i].data();
+    }
+    //Software stamps only: a CAN controller's hardware clock is free running rather than Unix time, which frame
+    //timestamps, the latency histogram and captures all need
+    const int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_SOFTWARE;
+    if(setsockopt(sockFd_, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) < 0) {
+        Logger::instance().warn("AsioCanSocket", "Kernel receive timestamps unavailable - " + std::string(strerror(errno)));
+    }
+    //Ask the kernel to tell us with every read how many frames it has thrown away because we were too slow
+    const int enable = 1;
+    if(setsockopt(sockFd_, SOL_SOCKET, SO_RXQ_OVFL, &enable, sizeof(enable)) < 0) {
+        Logger::instance().warn("AsioCanSocket", "Receive queue overflow reporting unavailable - " + std::string(strerror(errno)));
+    }
+}
+
+void AsioCanSocket::installReceiveFilters() const {
+    //Only PGNs we can decode are worth reading; the config filter narrows that further when it is set
+    const std::vector<uint32_t> known = N2KPropertyProvider::instance().pgns();
+    std::set<uint32_t> wanted;
+    if(const auto& configFilter = ConfigProvider::instance().nmeaPgnFilter(); configFilter.empty()) {
+        wanted.insert(known.begin(), known.end());
+    } else {
+        for(const int pgn : configFilter) {
+            if(std::ranges::find(known, static_cast<uint32_t>(pgn)) == known.end()) {
+                Logger::instance().warn("AsioCanSocket", "PGN " + std::to_string(pgn) + " in filter has no definition, ignoring");
+                continue;
+            }
+            wanted.insert(pgn);
+        }
+        //A filter with nothing we know would leave only network and GNSS traffic, so read everything instead
+        if(wanted.empty()) {
+            Logger::instance().warn("AsioCanSocket", "No PGN in filter has a definition, receiving all known PGNs");
+            wanted.insert(known.begin(), known.end());
+        }
+    }
+    wanted.insert(std::begin(NETWORK_PGNS), std::end(NETWORK_PGNS));
+    wanted.insert(std::begin(GNSS_PGNS), std::end(GNSS_PGNS));
+
+    std::vector<can_filter> filters;
+    filters.reserve(wanted.size());
+    for(const uint32_t pgn : wanted) {
+        //PDU1 PGNs carry the destination address in the PS byte, so it is masked out of the match
+        const uint32_t pgnMask = ((pgn >> 8) & 0xFF) < 240 ? 0x3FF00 : 0x3FFFF;
+        filters.push_back({
+            .can_id = ((pgn & pgnMask) << 8) | CAN_EFF_FLAG,
+            .can_mask = (pgnMask << 8) | CAN_EFF_FLAG | CAN_RTR_FLAG
+        });
+    }
+    if(setsockopt(sockFd_, SOL_CAN_RAW, CAN_RAW_FILTER, filters.data(), filters.size() * sizeof(can_filter)) < 0) {
+        Logger::instance().error("AsioCanSocket", "Failed to install CAN receive filters - " + std::string(strerror(errno)));
+        return;
+    }
+    Logger::instance().info("AsioCanSocket", "Installed " + std::to_string(filters.size()) + " CAN receive filters");
+}
+
 void AsioCanSocket::readOperation(){
-    stream_.async_read_some( boost::asio::buffer(&recFrame_, sizeof(recFrame_)),
-                            [&](const boost::system::error_code &ec,
-                                std::size_t) {
-                                if(!ec) {
-                                    J1939Frame msg(recFrame_);
-                                    handleMessage(msg);
-                                } else {
-                                    Logger::instance().error("AsioCanSocket", "CAN Receive error - " + ec.message());
-                                }
-                                this->readOperation();
-                            });
+    stream_.async_wait(boost::asio::posix::descriptor_base::wait_read,
+                       [this](const boost::system::error_code &ec) {
+                           if(!ec) {
+                               receiveBatch();
+                           } else {
+                               Logger::instance().error("AsioCanSocket", "CAN Receive error - " + ec.message());
+                           }
+                           this->readOperation();
+                       });
+}
+
+void AsioCanSocket::receiveBatch() {
+    //Drain everything the kernel has queued, a full batch means there may be more waiting
+    int count;
+    do {
+        for(auto& msg : rxMsgs_) {
+            msg.msg_hdr.msg_controllen = rxControl_[0].size();
+        }
+        count = recvmmsg(sockFd_, rxMsgs_.data(), CAN_RX_BATCH, MSG_DONTWAIT, nullptr);
+        if(count < 0) {
+            if(errno != EAGAIN && errno != EWOULDBLOCK) {
+                Logger::instance().error("AsioCanSocket", "CAN Receive error - " + std::string(strerror(errno)));
+            }
+            break;
+        }
+        uint32_t dropped = 0;
+        for(int i = 0; i < count; i++) {
+            if(rxMsgs_[i].msg_len != sizeof(can_frame)) {
+                continue;
+            }
+            unsigned long long timestamp = 0;
+            readControl(rxMsgs_[i].msg_hdr, timestamp, dropped);
+            if(capture_) {
+                capture_->write(rxFrames_[i], timestamp != 0 ? timestamp : duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count());
+            }
+            J1939Frame msg(rxFrames_[i], timestamp);
+            handleMessage(msg);
+        }
+        if(dropped != 0) {
+            stats_.recordRxOverflow(dropped);
+        }
+    } while(count == CAN_RX_BATCH);
+    stats_.recordReassembly(fastPackets_.completed(), fastPackets_.timedOut(), fastPackets_.dropped());
+}
+
+void AsioCanSocket::injectFrame(can_frame frame, const unsigned long long timestamp) {
+    J1939Frame msg(frame, timestamp);
+    handleMessage(msg);
+}
+
+void AsioCanSocket::readControl(const msghdr& hdr, unsigned long long& timestamp, uint32_t& dropped) {
+    for(const cmsghdr* cmsg = CMSG_FIRSTHDR(&hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(const_cast<msghdr*>(&hdr), const_cast<cmsghdr*>(cmsg))) {
+        if(cmsg->cmsg_level != SOL_SOCKET) {
+            continue;
+        }
+        if(cmsg->cmsg_type == SO_TIMESTAMPING) {
+            scm_timestamping ts{};
+            memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+            //The software stamp is CLOCK_REALTIME, taken as the frame reached the kernel
+            const timespec& t = ts.ts[0];
+            timestamp = static_cast<unsigned long long>(t.tv_sec) * 1000000000ULL + t.tv_nsec;
+        } else if(cmsg->cmsg_type == SO_RXQ_OVFL) {
+            //Running total for the socket, so the latest one seen is the one that counts
+            memcpy(&dropped, CMSG_DATA(cmsg), sizeof(dropped));
+        }
+    }
 }
 
 std::array<uint8_t, 8> AsioCanSocket::calculateLocalName() const{
@@ -127,51 +273,149 @@ void AsioCanSocket::sendProductDetails(){
     buffer[132] = CERT_LEVEL;
     //Byte 133 Load Equivalency
     buffer[133] = LOAD_EQUIVALENCY;
-    write(126996, 0, 6, buffer, 134);
+    transmit(126996, 0, buffer, 134);
 }
 
 void AsioCanSocket::handleMessage(J1939Frame& frame){
+    const auto started = steady_clock::now();
     unsigned char length = frame.frameLength();
-    auto dpc = N2KPropertyProvider::instance().getPropertyContainer(std::to_string(frame.pgn()));
+    stats_.recordRx(frame.pgn(), frame.srcAddress(), length);
+    const N2KContainer* dpc = N2KPropertyProvider::instance().getPropertyContainer(frame.pgn());
     if(nullptr == dpc){
         Logger::instance().warn("AsioCanSocket", "Property container not found for " + std::to_string(frame.pgn()));
         return;
     }
     if(dpc->singleFrame){
-        CanMessage msg(dpc.get(), length, 0x00, frame.srcAddress(), frame.dstAddress());
+        CanMessage msg(dpc, length, 0x00, frame.srcAddress(), frame.dstAddress());
         msg.addToMessage(0x00, frame);
-        Logger::instance().trace("AsioCanSocket", "Received single frame message for " + std::to_string(frame.pgn()) + " ("+ dpc->name+") from address " + std::to_string(frame.srcAddress()));
+        LOG_TRACE("AsioCanSocket", "Received single frame message for " + std::to_string(frame.pgn()) + " ("+ dpc->name+") from address " + std::to_string(frame.srcAddress()));
         msg.populateFieldData();
         handleCompleteMessage(msg);
+        recordDecode(frame, started);
     } else {
-        unsigned char frameNo = frame.data()[0] & 0b00011111;
-        unsigned char sequence = frame.data()[0] & 0b11100000;
-        std::string msgRef = std::to_string(frame.srcAddress()) + "-" + std::to_string(frame.pgn()) + "-" + std::to_string(sequence);
-        if(frameNo == 0){
-            length = frame.data()[1];
-            CanMessage msg(dpc.get(), length, sequence, frame.srcAddress(), frame.dstAddress());
-            msg.addToMessage(frameNo, frame);
-            messageStore_[msgRef] = msg;
-        } else {
-            if(!messageStore_.contains(msgRef)){
-                Logger::instance().warn("AsioCanSocket", "No message found for " + msgRef);
-                return;
-            }
-            CanMessage msg = messageStore_[msgRef];
-            msg.addToMessage(frameNo, frame);
-            if(msg.isComplete()){
-                messageStore_.erase(msgRef);
-                Logger::instance().trace("AsioCanSocket", "Received complete message for " + msgRef);
-                msg.populateFieldData();
-                handleCompleteMessage(msg);
-            }
+        const unsigned long long now = frame.timestamp() != 0 ? frame.timestamp() / 1000000 : systemTimeMillis();
+        if(FastPacketSession* session = fastPackets_.addFrame(frame, now)){
+            CanMessage msg(dpc, session->length, session->sequence, session->source, session->destination);
+            msg.setPayload(session->payload.data(), session->length);
+            fastPackets_.release(session);
+            LOG_TRACE("AsioCanSocket", "Received complete message for " + std::to_string(frame.pgn()) + " from address " + std::to_string(frame.srcAddress()));
+            msg.populateFieldData();
+            handleCompleteMessage(msg);
+            recordDecode(frame, started);
         }
     }
 }
 
+void AsioCanSocket::recordDecode(J1939Frame& frame, const steady_clock::time_point started) {
+    const auto decodeNanos = duration_cast<nanoseconds>(steady_clock::now() - started).count();
+    unsigned long long latencyNanos = 0;
+    if(frame.timestamp() != 0) {
+        //Kernel stamps are on the realtime clock
+        const unsigned long long now = duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+        latencyNanos = now > frame.timestamp() ? now - frame.timestamp() : 0;
+    }
+    stats_.recordDecode(frame.pgn(), decodeNanos, latencyNanos);
+}
+
+CanStatsSnapshot AsioCanSocket::statistics() {
+    CanStatsSnapshot snapshot = stats_.snapshot();
+    snapshot.txQueueDropped = txQueue_.dropped();
+    snapshot.txCoalesced = txScheduler_.coalesced();
+    snapshot.txBudgetDeferrals = txScheduler_.budgetDeferrals();
+    return snapshot;
+}
+
+void AsioCanSocket::scheduleStatsSummary() {
+    if(statsIntervalSec_ == 0) {
+        return;
+    }
+    statsTimer_.expires_after(boost::asio::chrono::seconds(statsIntervalSec_));
+    statsTimer_.async_wait([this](const boost::system::error_code& ec) {
+        if(!ec) {
+            logStatsSummary();
+            scheduleStatsSummary();
+        }
+    });
+}
+
+void AsioCanSocket::logStatsSummary() {
+    const CanStatsSnapshot current = statistics();
+    const CanStatsSnapshot& last = lastSummary_;
+    const double seconds = current.takenAt > last.takenAt ? (current.takenAt - last.takenAt) / 1000.0 : 1.0;
+    const double busLoad = 100.0 * (current.rxBits - last.rxBits + current.txBits - last.txBits) / (seconds * bitrate_);
+
+    CanHistogram decodeTime;
+    CanHistogram latency;
+    for(size_t i = 0; i < CAN_HISTOGRAM_BUCKETS; i++) {
+        decodeTime[i] = current.decodeTime[i] - last.decodeTime[i];
+        latency[i] = current.latency[i] - last.latency[i];
+    }
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(1)
+        << "rx " << (current.rxFrames - last.rxFrames) / seconds << " frames/s"
+        << ", tx " << (current.txFrames - last.txFrames) / seconds << " frames/s"
+        << ", bus load " << busLoad << "%"
+        << ", rx overflows " << current.rxOverflows - last.rxOverflows
+        << ", fast packets " << current.fastPacketCompleted - last.fastPacketCompleted << " complete "
+        << current.fastPacketTimedOut - last.fastPacketTimedOut << " timed out "
+        << current.fastPacketDropped - last.fastPacketDropped << " dropped"
+        << ", tx queue drops " << current.txQueueDropped - last.txQueueDropped
+        << ", decode p50/p99 " << histogramPercentile(decodeTime, 0.5) << "/" << histogramPercentile(decodeTime, 0.99) << "us"
+        << ", latency p50/p99 " << histogramPercentile(latency, 0.5) << "/" << histogramPercentile(latency, 0.99) << "us";
+    Logger::instance().info("AsioCanSocket", out.str());
+
+    //The busiest PGNs and sources are what to look at first when the bus load climbs
+    struct Rate {
+        uint32_t id;
+        unsigned long long frames;
+        unsigned long long messages;
+        unsigned long long decodeNanos;
+    };
+    std::vector<Rate> pgnRates;
+    for(const auto& stats : current.pgns) {
+        const auto prev = std::ranges::lower_bound(last.pgns, stats.pgn, {}, &CanPgnStats::pgn);
+        const bool seen = prev != last.pgns.end() && prev->pgn == stats.pgn;
+        Rate rate{stats.pgn, stats.frames, stats.messages, stats.decodeNanos};
+        if(seen) {
+            rate.frames -= prev->frames;
+            rate.messages -= prev->messages;
+            rate.decodeNanos -= prev->decodeNanos;
+        }
+        if(rate.frames != 0) {
+            pgnRates.push_back(rate);
+        }
+    }
+    std::vector<Rate> sourceRates;
+    for(size_t i = 0; i < current.sourceFrames.size(); i++) {
+        if(const unsigned long long frames = current.sourceFrames[i] - last.sourceFrames[i]; frames != 0) {
+            sourceRates.push_back({static_cast<uint32_t>(i), frames, 0, 0});
+        }
+    }
+    const auto busiest = [](const Rate& a, const Rate& b) { return a.frames > b.frames; };
+    std::ranges::sort(pgnRates, busiest);
+    std::ranges::sort(sourceRates, busiest);
+
+    std::ostringstream top;
+    top << std::fixed << std::setprecision(1) << "Top PGNs:";
+    for(size_t i = 0; i < std::min<size_t>(pgnRates.size(), CAN_STATS_TOP_COUNT); i++) {
+        const Rate& rate = pgnRates[i];
+        top << " " << rate.id << " " << rate.frames / seconds << "/s";
+        if(rate.messages != 0) {
+            top << " (" << rate.decodeNanos / rate.messages / 1000.0 << "us)";
+        }
+    }
+    top << "; top sources:";
+    for(size_t i = 0; i < std::min<size_t>(sourceRates.size(), CAN_STATS_TOP_COUNT); i++) {
+        top << " " << sourceRates[i].id << " " << sourceRates[i].frames / seconds << "/s";
+    }
+    Logger::instance().info("AsioCanSocket", top.str());
+    lastSummary_ = current;
+}
+
 CanDevice* AsioCanSocket::getOrCreateDevice(uint8_t addr){
     if(!deviceStore_.contains(addr)) {
-        Logger::instance().trace("AsioCanSocket", "Creating new device reference at addr " + std::to_string(addr));
+        LOG_TRACE("AsioCanSocket", "Creating new device reference at addr " + std::to_string(addr));
         auto device = CanDevice();
         device.address = addr;
         deviceStore_.emplace(addr, device);
@@ -181,18 +425,18 @@ CanDevice* AsioCanSocket::getOrCreateDevice(uint8_t addr){
 
 void AsioCanSocket::handleCompleteMessage(CanMessage &msg) {
     if(msg.pgn() == "60928"){
-        Logger::instance().debug("AsioCanSocket", "Address claim received");
+        LOG_DEBUG("AsioCanSocket", "Address claim received");
         processAddressClaim(msg);
         return;
     }
     CanDevice* device = getOrCreateDevice(msg.source());
     switch(stringHash(msg.pgn().c_str())) {
         case stringHash("59904"): {
-            Logger::instance().debug("AsioCanSocket", "ISO Request");
+            LOG_DEBUG("AsioCanSocket", "ISO Request");
             if (msg.destination() == localAddress_ || msg.destination() == 255) {
                 const int pgn = (msg.data()[2] & 0xFF) << 16 | (msg.data()[1] & 0xFF) << 8 |
                           (msg.data()[0] & 0xFF);
-                Logger::instance().debug("AsioCanSocket", "Requested PGN: " + std::to_string(pgn));
+                LOG_DEBUG("AsioCanSocket", "Requested PGN: " + std::to_string(pgn));
                 if (pgn == 60928) {
                     addressClaim();
                 } else if (pgn == 126996) {
@@ -220,16 +464,27 @@ void AsioCanSocket::handleCompleteMessage(CanMessage &msg) {
             std::cout << "Alert" << std::endl;
             break;
         }
-
+        case stringHash("129026"):
+        case stringHash("129029"): {
+            publishGnssPosition(msg);
+            //Still reported as properties below
+            [[fallthrough]];
+        }
         default:{
-            const auto ev = std::make_shared<NMEAPropertyEvent>(device->uid);
-            for(const auto& [key, val] : msg.stringMap()){
+            NMEAPropertyEvent* ev = nullptr;
+            const unsigned long long now = systemTimeMillis();
+            for(const auto& fv : msg.fieldValues()){
                 //Only send update if values have changed
-                if(device->updateValue(key, msg.instance(), val)){
-                    ev->addValue(key, msg.instance(), val);
+                if(fv.numeric && device->updateValue(msg.pgnNumber(), fv.step->fieldIndex, msg.instanceId(), fv.value,
+                                                     fv.step->deadband, fv.step->heartbeatMs, now)){
+                    if(ev == nullptr){
+                        ev = acquireEvent<NMEAPropertyEvent>();
+                        ev->deviceUid = device->uid;
+                    }
+                    ev->addValue(fv.property->uid, msg.instance(), fv.text);
                 }
             }
-            if(!ev->values().empty()){
+            if(ev != nullptr){
                 EventDispatcher::instance().dispatchAsync(ev);
             }
             break;
@@ -237,57 +492,107 @@ void AsioCanSocket::handleCompleteMessage(CanMessage &msg) {
     }
 }
 
-void AsioCanSocket::write(const uint32_t pgn, const uint8_t remoteAddress, const uint8_t priority, const uint8_t* data, const uint8_t dataSize){
-
-    if(const auto dpc = N2KPropertyProvider::instance().getPropertyContainer(std::to_string(pgn)); nullptr != dpc && !dpc->singleFrame){
-        static uint8_t seq = 0;
-        size_t offset = 0;
-        uint8_t frameNo = 0;
-        uint8_t arr[8] = {};
-        for (int i = 0; i < 8; i++) arr[i] = 0xFF;
-        arr[0] = (uint8_t)((seq & 0x07 << 5) | (frameNo & 0x1f));
-        arr[1] = (uint8_t) dataSize;
-        size_t n0 = (dataSize < 6) ? dataSize : 6;
-        for (size_t i = 0; i < n0; i++) {
-            arr[2 + i] = data[i];
+void AsioCanSocket::publishGnssPosition(CanMessage& msg) {
+    const std::vector<uint8_t> data = msg.data();
+    if (msg.pgnNumber() == 129026) {
+        if (data.size() < 6) {
+            return;
         }
-
-        offset += n0;
-        frameNo++;
-        const can_frame frame = generateFrame(pgn, remoteAddress, priority, arr);
-        writeRawFrame(frame);
-        while (offset < dataSize) {
-            uint8_t followUp[8];
-            for (int i = 0; i < 8; i++) followUp[i] = 0xFF;
-
-            followUp[0] = (uint8_t)(((seq & 0x07) << 5) | (frameNo & 0x1F));
-
-            size_t n = dataSize - offset;
-            if (n > 7) n = 7;
-
-            for (size_t i = 0; i < n; i++) {
-                followUp[1 + i] = data[offset + i];
-            }
-
-            offset += n;
-            frameNo++;
-
-            writeRawFrame(generateFrame(pgn, remoteAddress, priority, followUp));
+        //Only true COG is useful as a heading
+        const uint16_t cog = boost::endian::load_little_u16(data.data() + 2);
+        const uint16_t sog = boost::endian::load_little_u16(data.data() + 4);
+        auto* ev = acquireEvent<GNSSPositionEvent>();
+        ev->source = N2K;
+        if ((data[1] & 0x03) == 0 && cog < 0xFFFD) {
+            ev->heading = cog * 1e-4 * 57.2957795;
+        }
+        if (sog < 0xFFFD) {
+            ev->speed = sog * 0.01;
         }
+        EventDispatcher::instance().dispatchAsync(ev);
+        return;
+    }
+    if (data.size() < 36) {
+        return;
+    }
+    const int64_t lat = boost::endian::load_little_s64(data.data() + 7);
+    const int64_t lon = boost::endian::load_little_s64(data.data() + 15);
+    const int64_t alt = boost::endian::load_little_s64(data.data() + 23);
+    const uint8_t method = data[31] >> 4;
+    //Method 0 is no fix, anything past estimated (manual input, simulator) is not a real position
+    if (lat == INT64_MAX || lon == INT64_MAX || method == 0 || method > 6) {
+        return;
+    }
+    static constexpr GNSSFixQuality METHOD_QUALITY[] = {
+        FIX_UNKNOWN, FIX_GNSS, FIX_DGNSS, FIX_GNSS, FIX_RTK_FIXED, FIX_RTK_FLOAT, FIX_DEAD_RECKONING
+    };
+    const uint32_t time = boost::endian::load_little_u32(data.data() + 3);
+    const int16_t hdop = boost::endian::load_little_s16(data.data() + 34);
+
+    auto* ev = acquireEvent<GNSSPositionEvent>();
+    ev->source = N2K;
+    ev->latitude = lat * 1e-16;
+    ev->longitude = lon * 1e-16;
+    if (alt != INT64_MAX) {
+        ev->altitude = alt * 1e-6;
+    }
+    if (hdop != INT16_MAX) {
+        ev->hdop = hdop * 0.01;
+    }
+    if (time < 0xFFFFFFFD) {
+        ev->timeOfFix = time * 1e-4;
+    }
+    ev->fixQuality = METHOD_QUALITY[method];
+    ev->constellation = COMBINED;
+    EventDispatcher::instance().dispatchAsync(ev);
+}
 
-        seq = (uint8_t)((seq + 1) & 0x07);
+void AsioCanSocket::write(const uint32_t pgn, const uint8_t remoteAddress, const uint8_t priority, const uint8_t* data, const size_t dataSize){
+    const canid_t header = frameHeader(pgn, remoteAddress, priority);
+    bool queued;
+    if(const auto dpc = N2KPropertyProvider::instance().getPropertyContainer(pgn); nullptr != dpc && !dpc->singleFrame){
+        if(dataSize > FAST_PACKET_MAX_PAYLOAD) {
+            Logger::instance().warn("AsioCanSocket", "PGN " + std::to_string(pgn) + " payload of " + std::to_string(dataSize) + " bytes is too long for a fast packet");
+            return;
+        }
+        const uint8_t seq = txSequence_.fetch_add(1) & 0x07;
+        const size_t frameCount = dataSize <= 6 ? 1 : 1 + (dataSize - 6 + 6) / 7;
+        queued = txQueue_.enqueue(frameCount, [&](can_frame& frame, const size_t frameNo) {
+            frame.can_id = header;
+            frame.can_dlc = 8;
+            memset(frame.data, 0xFF, 8);
+            frame.data[0] = static_cast<uint8_t>(seq << 5 | (frameNo & 0x1F));
+            if(frameNo == 0) {
+                frame.data[1] = static_cast<uint8_t>(dataSize);
+                memcpy(frame.data + 2, data, std::min<size_t>(dataSize, 6));
+            } else {
+                const size_t offset = 6 + (frameNo - 1) * 7;
+                memcpy(frame.data + 1, data + offset, std::min<size_t>(dataSize - offset, 7));
+            }
+        });
     } else {
-        const can_frame frame = generateFrame(pgn, remoteAddress, priority, data);
-        writeRawFrame(frame);
+        queued = txQueue_.enqueue(1, [&](can_frame& frame, size_t) {
+            frame.can_id = header;
+            frame.can_dlc = 8;
+            memset(frame.data, 0xFF, 8);
+            memcpy(frame.data, data, std::min<size_t>(dataSize, 8));
+        });
+    }
+    if(!queued) {
+        Logger::instance().warn("AsioCanSocket", "Transmit queue full, dropping PGN " + std::to_string(pgn));
     }
+    scheduleFlush();
 }
 
-void AsioCanSocket::handlePositionEvent(const std::shared_ptr<PositionEvent>& ev) {
+void AsioCanSocket::handlePositionEvent(const PositionEvent& ev) {
     static uint8_t sid = 0;
-    const int32_t lat = ev->latitude * 1e7;
-    const int32_t lon = ev->longitude * 1e7;
-    const uint16_t hdg = ev->heading * 0.0174533 * 1e4;
-    const uint16_t spd = ev->speed * 100;
+    if (!ev.fixValid) {
+        return;
+    }
+    const int32_t lat = ev.latitude * 1e7;
+    const int32_t lon = ev.longitude * 1e7;
+    const uint16_t hdg = ev.heading * 0.0174533 * 1e4;
+    const uint16_t spd = ev.speed * 100;
 
     uint8_t posRapid[8];
     uint8_t cogSog[8];
@@ -311,18 +616,21 @@ void AsioCanSocket::handlePositionEvent(const std::shared_ptr<PositionEvent>& ev
     cogSog[6] = 0xFF;
     cogSog[7] = 0xFF;
 
-    write(129025, 255, 6, posRapid, 8);
-    write(129026, 255, 6, cogSog, 8);
+    transmit(129025, 255, posRapid, 8);
+    transmit(129026, 255, cogSog, 8);
     sid++;
 }
 
-void AsioCanSocket::handleSatellitesEvent(const std::shared_ptr<GNSSSatellitesEvent>& ev) {
+void AsioCanSocket::handleSatellitesEvent(const GNSSSatellitesEvent& ev) {
     static uint8_t sid = 0;
     std::vector<uint8_t> data;
     data.push_back(sid);
     data.push_back(0x03 | 0xFC);
-    data.push_back((uint8_t)(ev->satsInView & 0xFF));
-    for (auto& sat : ev->satellites) {
+    //12 bytes a satellite after the 3 byte header, so a fast packet holds 18; the count is what actually follows
+    const size_t records = std::min<size_t>(ev.satellites.size(), (FAST_PACKET_MAX_PAYLOAD - 3) / 12);
+    data.push_back(static_cast<uint8_t>(records));
+    for (size_t i = 0; i < records; i++) {
+        const auto& sat = ev.satellites[i];
         data.push_back(sat.satelliteId & 0xFF);
         int16_t elev = round(sat.elevation * 1e4 * 0.0174533);
         data.push_back((uint8_t)(elev & 0xFF));
@@ -339,23 +647,121 @@ void AsioCanSocket::handleSatellitesEvent(const std::shared_ptr<GNSSSatellitesEv
         data.push_back(0x7F);
         data.push_back(0xFF);
     }
-    write(129540, 255, 6, data.data(), data.size());
+    //GnssReader sends one event per constellation, each has to reach the bus rather than replace the one before
+    transmit(129540, 255, data.data(), data.size(), static_cast<uint8_t>(ev.constellation));
+}
+
+void AsioCanSocket::transmit(const uint32_t pgn, const uint8_t remoteAddress, const uint8_t* data, const size_t dataSize,
+                             const uint8_t stream) {
+    const N2KContainer* dpc = N2KPropertyProvider::instance().getPropertyContainer(pgn);
+    if(nullptr == dpc) {
+        Logger::instance().warn("AsioCanSocket", "No definition for outgoing PGN " + std::to_string(pgn));
+        return;
+    }
+    const unsigned int frameCount = dpc->singleFrame || dataSize <= 6 ? 1 : 1 + (dataSize - 6 + 6) / 7;
+    if(!txScheduler_.submit(pgn, remoteAddress, stream, dpc->defaultPriority, dpc->defaultUpdateRate, frameCount, data,
+                            dataSize, systemTimeMillis())) {
+        Logger::instance().warn("AsioCanSocket", "PGN " + std::to_string(pgn) + " payload of " +
+                                std::to_string(dataSize) + " bytes does not fit a fast packet, dropping");
+        return;
+    }
+    boost::asio::post(stream_.get_executor(), [this]() { serviceTx(); });
 }
 
-void AsioCanSocket::writeRawFrame(can_frame frame){
-    stream_.async_write_some(boost::asio::buffer(&frame, sizeof(frame)),
-                            [&](const boost::system::error_code &ec,
-                                    const std::size_t bytes_transferred){asyncWriteHandler(ec, bytes_transferred);});
+void AsioCanSocket::serviceTx() {
+    const long long wait = txScheduler_.service(systemTimeMillis(), [this](const CanTxSlot& slot) {
+        write(slot.pgn, slot.destination, slot.priority, slot.payload.data(), slot.length);
+    });
+    if(wait >= 0) {
+        txScheduleTimer_.expires_after(boost::asio::chrono::milliseconds(wait));
+        txScheduleTimer_.async_wait([this](const boost::system::error_code& ec) {
+            if(!ec) {
+                serviceTx();
+            }
+        });
+    }
 }
 
-void AsioCanSocket::asyncWriteHandler(const boost::system::error_code &ec, const std::size_t transferred) {
-    if(!ec){
-        Logger::instance().trace("AsioCanSocket", std::to_string(transferred) + " bytes written to socket successfully");
-    } else {
-        Logger::instance().error("AsioCanSocket", "CAN error while writing to socket - " + ec.message());
+void AsioCanSocket::writeRawFrame(const can_frame frame){
+    if(!txQueue_.enqueue(1, [&](can_frame& slot, size_t) { slot = frame; })) {
+        Logger::instance().warn("AsioCanSocket", "Transmit queue full, dropping frame");
+    }
+    scheduleFlush();
+}
+
+void AsioCanSocket::scheduleFlush() {
+    if(!flushScheduled_.exchange(true)) {
+        boost::asio::post(stream_.get_executor(), [this]() { flushTx(); });
     }
 }
 
+void AsioCanSocket::flushTx() {
+    //Runs on the io context only, so the mmsghdr arrays are ours
+    for(;;) {
+        can_frame* frames;
+        const size_t count = txQueue_.peek(frames, CAN_TX_BATCH);
+        if(count == 0) {
+            flushScheduled_ = false;
+            //A producer may have queued after the peek but before the flag was cleared
+            if(txQueue_.empty() || flushScheduled_.exchange(true)) {
+                return;
+            }
+            continue;
+        }
+        if(!stream_.is_open()) {
+            //No interface, e.g. while replaying a capture on a dev box
+            txQueue_.consume(count);
+            continue;
+        }
+        for(size_t i = 0; i < count; i++) {
+            txIov_[i].iov_base = &frames[i];
+            txIov_[i].iov_len = sizeof(can_frame);
+            txMsgs_[i].msg_hdr = {};
+            txMsgs_[i].msg_hdr.msg_iov = &txIov_[i];
+            txMsgs_[i].msg_hdr.msg_iovlen = 1;
+        }
+        const int sent = sendmmsg(sockFd_, txMsgs_.data(), count, MSG_DONTWAIT);
+        if(sent < 0) {
+            if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                stream_.async_wait(boost::asio::posix::descriptor_base::wait_write,
+                                   [this](const boost::system::error_code& ec) {
+                                       if(ec != boost::asio::error::operation_aborted) {
+                                           flushTx();
+                                       }
+                                   });
+                return;
+            }
+            if(errno == ENOBUFS) {
+                //The controller's queue is full and the socket will still poll as writable, back off instead
+                txRetryTimer_.expires_after(boost::asio::chrono::milliseconds(1));
+                txRetryTimer_.async_wait([this](const boost::system::error_code& ec) {
+                    if(!ec) {
+                        flushTx();
+                    }
+                });
+                return;
+            }
+            Logger::instance().error("AsioCanSocket", "CAN error while writing to socket - " + std::string(strerror(errno)));
+            txQueue_.consume(count);
+            continue;
+        }
+        LOG_TRACE("AsioCanSocket", std::to_string(sent) + " frames written to socket successfully");
+        //Everything we queue is padded out to a full 8 byte frame
+        stats_.recordTx(sent, 8);
+        txQueue_.consume(sent);
+    }
+}
+
+canid_t AsioCanSocket::frameHeader(const uint32_t pgn, const uint8_t remoteAddress, const uint8_t priority) {
+    const uint32_t key = (pgn & 0x3FFFF) << 11 | (priority & 0x07) << 8 | remoteAddress;
+    std::lock_guard lock(headerLock_);
+    auto it = headerTemplates_.find(key);
+    if(it == headerTemplates_.end()) {
+        it = headerTemplates_.emplace(key, (generateHeader(pgn, remoteAddress, priority) & ~0xFFu) | CAN_EFF_FLAG).first;
+    }
+    return it->second | localAddress_;
+}
+
 uint32_t AsioCanSocket::generateHeader(const uint32_t pgn, const uint8_t remoteAddress, const uint8_t priority) const{
     uint32_t can_id = 0;
     const uint8_t pf = (pgn >> 8) & 0xFF;
@@ -374,21 +780,3 @@ uint32_t AsioCanSocket::generateHeader(const uint32_t pgn, const uint8_t remoteA
 
     return can_id;
 }
-
-can_frame AsioCanSocket::generateFrame(const uint32_t pgn, const uint8_t remoteAddress, const uint8_t priority, const uint8_t* data) const{
-    can_frame frame = {};
-    frame.can_id = generateHeader(pgn, remoteAddress, priority);
-    frame.can_id |= CAN_EFF_FLAG;
-    frame.can_dlc = 8;
-    memcpy(frame.data, data, 8);
-    return frame;
-}
-
-void AsioCanSocket::notifyMessage(const std::shared_ptr<Event> ev) {
-    if (ev->eventType() == POSITION) {
-        handlePositionEvent(std::dynamic_pointer_cast<PositionEvent>(ev));
-    }
-    if (ev->eventType() == GNSS_SATELLITES) {
-        handleSatellitesEvent(std::dynamic_pointer_cast<GNSSSatellitesEvent>(ev));
-    }
-}
@@ -1,16 +1,28 @@
 #ifndef ASIOCANSOCKET_H
 #define ASIOCANSOCKET_H
 
+#include <atomic>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <unistd.h>
 #include <boost/asio.hpp>
 #include <linux/can.h>
+#include <linux/errqueue.h>
+#include <sys/socket.h>
 #include <sys/types.h>
+#include "CanCapture.h"
 #include "CanDevice.h"
 #include "CanMessage.h"
+#include "CanStatistics.h"
+#include "CanTxQueue.h"
+#include "CanTxScheduler.h"
+#include "FastPacketTable.h"
 #include "J1939Frame.h"
 #include "../event/Event.h"
 #include "../event/EventDispatcher.h"
+#include "../utils/TimeUtils.h"
 
 static constexpr uint16_t MFR_CODE = 1100;
 static constexpr uint8_t DEV_CLASS = 0x19;
@@ -23,36 +35,83 @@ static constexpr char MODEL_VERSION[] = "Riedel SmartChase";
 static constexpr char SERIAL_NO[] = "42";
 static constexpr uint8_t CERT_LEVEL = 2;
 static constexpr uint8_t LOAD_EQUIVALENCY = 3;
+static constexpr size_t CAN_RX_BATCH = 64;
+static constexpr size_t CAN_TX_BATCH = 64;
+//How many PGNs and source addresses the periodic statistics summary lists
+static constexpr size_t CAN_STATS_TOP_COUNT = 5;
+//PGNs handled by the network management code, these are always let through the receive filter
+static constexpr uint32_t NETWORK_PGNS[] = {59904, 60928, 126993, 126996};
+//PGNs from other GNSS receivers on the bus, fed to the location provider as the N2K source
+static constexpr uint32_t GNSS_PGNS[] = {129026, 129029};
 
 class AsioCanSocket final: public EventListener {
 public:
     AsioCanSocket(const std::string& interfaceName, boost::asio::io_context& ioCtx);
     void writeRawFrame(can_frame frame);
     void readOperation();
+    ///
+    /// Runs a frame through the same decode path as one read from the socket. Must be called on the socket's io
+    /// context; used to replay captures.
+    ///
+    void injectFrame(can_frame frame, unsigned long long timestamp);
     [[nodiscard]] uint32_t generateHeader(uint32_t pgn, uint8_t remoteAddress, uint8_t priority) const;
-    can_frame generateFrame(uint32_t pgn, uint8_t remoteAddress, uint8_t priority, const uint8_t* data) const;
 
-    void notifyMessage(std::shared_ptr<Event> ev) override;
+    /// Copy of the bus and decoder counters, safe to call from any thread
+    [[nodiscard]] CanStatsSnapshot statistics();
+
+    [[nodiscard]] bool serialized() const override { return true; }
 private:
-    int sockFd_;
+    int sockFd_ = -1;
     boost::asio::posix::basic_stream_descriptor<> stream_;
-    can_frame recFrame_ = {};
-    uint8_t localAddress_ = 42;
-    std::map<std::string, CanMessage> messageStore_;
+    std::array<can_frame, CAN_RX_BATCH> rxFrames_ = {};
+    std::array<iovec, CAN_RX_BATCH> rxIov_ = {};
+    std::array<mmsghdr, CAN_RX_BATCH> rxMsgs_ = {};
+    std::array<std::array<char, CMSG_SPACE(sizeof(scm_timestamping)) + CMSG_SPACE(sizeof(uint32_t))>, CAN_RX_BATCH> rxControl_ = {};
+    CanTxScheduler txScheduler_;
+    boost::asio::steady_timer txScheduleTimer_;
+    CanTxQueue txQueue_;
+    std::array<iovec, CAN_TX_BATCH> txIov_ = {};
+    std::array<mmsghdr, CAN_TX_BATCH> txMsgs_ = {};
+    std::atomic<bool> flushScheduled_ = false;
+    boost::asio::steady_timer txRetryTimer_;
+    std::atomic<uint8_t> txSequence_ = 0;
+    //Header for each (PGN, priority, destination) without our source address, which is ORed in on use
+    std::mutex headerLock_;
+    std::unordered_map<uint32_t, canid_t> headerTemplates_;
+    std::atomic<uint8_t> localAddress_ = 42;
+    FastPacketTable fastPackets_;
     std::map<uint8_t, CanDevice> deviceStore_;
+    CanStatistics stats_;
+    CanStatsSnapshot lastSummary_;
+    unsigned int bitrate_;
+    unsigned int statsIntervalSec_;
+    boost::asio::steady_timer statsTimer_;
+    std::unique_ptr<CanCaptureWriter> capture_;
 
-    static void asyncWriteHandler(const boost::system::error_code& ec, std::size_t transferred);
+    canid_t frameHeader(uint32_t pgn, uint8_t remoteAddress, uint8_t priority);
+    void transmit(uint32_t pgn, uint8_t remoteAddress, const uint8_t* data, size_t dataSize, uint8_t stream = 0);
+    void serviceTx();
+    void scheduleFlush();
+    void flushTx();
+    void setupReceiveBatch();
+    void installReceiveFilters() const;
+    void receiveBatch();
+    static void readControl(const msghdr& hdr, unsigned long long& timestamp, uint32_t& dropped);
     void handleMessage(J1939Frame& frame);
+    void recordDecode(J1939Frame& frame, std::chrono::steady_clock::time_point started);
+    void scheduleStatsSummary();
+    void logStatsSummary();
     CanDevice* getOrCreateDevice(uint8_t addr);
     void handleCompleteMessage(CanMessage& msg);
     void processAddressClaim(CanMessage& msg);
+    static void publishGnssPosition(CanMessage& msg);
     void genericISORequest(uint32_t pgn, uint8_t addr);
     void sendProductDetails();
     void addressClaim();
-    void write(uint32_t pgn, uint8_t remoteAddress, uint8_t priority, const uint8_t *data, uint8_t dataSize);
+    void write(uint32_t pgn, uint8_t remoteAddress, uint8_t priority, const uint8_t *data, size_t dataSize);
 
-    void handlePositionEvent(const std::shared_ptr<PositionEvent>& ev);
-    void handleSatellitesEvent(const std::shared_ptr<GNSSSatellitesEvent>& ev);
+    void handlePositionEvent(const PositionEvent& ev);
+    void handleSatellitesEvent(const GNSSSatellitesEvent& ev);
 
     std::array<uint8_t, 8> calculateLocalName() const;
 
@@ -0,0 +1,223 @@
+#ifndef CANCAPTURE_H
+#define CANCAPTURE_H
+
+#include <cctype>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <boost/endian/conversion.hpp>
+#include <linux/can.h>
+
+//Binary captures start with this magic, the last byte is the format version
+static constexpr char CAN_CAPTURE_MAGIC[8] = {'S', 'G', 'P', 'C', 'A', 'N', '\0', '\1'};
+//Binary record: u64 timestamp (ns), u32 CAN ID with flags, u8 DLC, 3 bytes padding, 8 data bytes, all little endian
+static constexpr size_t CAN_CAPTURE_RECORD_SIZE = 24;
+static constexpr size_t CAN_CAPTURE_BUFFER_SIZE = 64 * 1024;
+//Captures are flushed at least this often so a crash loses at most this much traffic
+static constexpr unsigned long long CAN_CAPTURE_FLUSH_NS = 1000000000ULL;
+
+enum class CanCaptureFormat {
+    CANDUMP = 0,
+    BINARY
+};
+
+///
+/// Records received frames to a file. CANDUMP writes the candump -l log format, one "(sec.usec) iface id#data" line
+/// per frame, so captures can be fed to can-utils canplayer and log2asc. BINARY writes fixed size records with the
+/// full nanosecond timestamp, a third of the size and nothing to parse on replay. Writes go through a large stdio
+/// buffer so the receive loop only pays for a memcpy per frame.
+///
+class CanCaptureWriter {
+public:
+    CanCaptureWriter(const std::string& path, const CanCaptureFormat format, std::string interfaceName):
+        format_(format), interfaceName_(std::move(interfaceName)) {
+        file_ = std::fopen(path.c_str(), format == CanCaptureFormat::BINARY ? "wb" : "w");
+        if (file_ == nullptr) {
+            return;
+        }
+        std::setvbuf(file_, nullptr, _IOFBF, CAN_CAPTURE_BUFFER_SIZE);
+        if (format_ == CanCaptureFormat::BINARY) {
+            std::fwrite(CAN_CAPTURE_MAGIC, 1, sizeof(CAN_CAPTURE_MAGIC), file_);
+        }
+    }
+
+    ~CanCaptureWriter() {
+        if (file_ != nullptr) {
+            std::fclose(file_);
+        }
+    }
+
+    CanCaptureWriter(const CanCaptureWriter&) = delete;
+    CanCaptureWriter& operator=(const CanCaptureWriter&) = delete;
+
+    [[nodiscard]] bool isOpen() const { return file_ != nullptr; }
+
+    void write(const can_frame& frame, const unsigned long long timestamp) {
+        if (file_ == nullptr) {
+            return;
+        }
+        if (format_ == CanCaptureFormat::BINARY) {
+            uint8_t record[CAN_CAPTURE_RECORD_SIZE] = {};
+            boost::endian::store_little_u64(record, timestamp);
+            boost::endian::store_little_u32(record + 8, frame.can_id);
+            record[12] = frame.can_dlc;
+            std::memcpy(record + 16, frame.data, 8);
+            std::fwrite(record, 1, sizeof(record), file_);
+        } else {
+            writeCandumpLine(frame, timestamp);
+        }
+        if (timestamp - lastFlush_ > CAN_CAPTURE_FLUSH_NS) {
+            std::fflush(file_);
+            lastFlush_ = timestamp;
+        }
+    }
+
+private:
+    std::FILE* file_ = nullptr;
+    CanCaptureFormat format_;
+    std::string interfaceName_;
+    unsigned long long lastFlush_ = 0;
+
+    void writeCandumpLine(const can_frame& frame, const unsigned long long timestamp) {
+        static constexpr char HEX[] = "0123456789ABCDEF";
+        char id[9];
+        const bool extended = frame.can_id & CAN_EFF_FLAG;
+        const canid_t value = frame.can_id & (extended ? CAN_EFF_MASK : CAN_SFF_MASK);
+        const int idDigits = extended ? 8 : 3;
+        for (int i = 0; i < idDigits; i++) {
+            id[i] = HEX[(value >> (4 * (idDigits - 1 - i))) & 0x0F];
+        }
+        id[idDigits] = '\0';
+        char data[17];
+        const uint8_t dlc = frame.can_dlc > 8 ? 8 : frame.can_dlc;
+        for (uint8_t i = 0; i < dlc; i++) {
+            data[2 * i] = HEX[frame.data[i] >> 4];
+            data[2 * i + 1] = HEX[frame.data[i] & 0x0F];
+        }
+        data[2 * dlc] = '\0';
+        std::fprintf(file_, "(%010llu.%06llu) %s %s#%s\n", timestamp / 1000000000ULL, timestamp / 1000 % 1000000,
+                     interfaceName_.c_str(), id, (frame.can_id & CAN_RTR_FLAG) ? "R" : data);
+    }
+};
+
+///
+/// Reads frames back from a capture in either format, telling them apart by the binary magic. Lines that are not
+/// valid candump frames (comments, CAN FD, error frames) are skipped.
+///
+class CanCaptureReader {
+public:
+    explicit CanCaptureReader(const std::string& path) {
+        file_ = std::fopen(path.c_str(), "rb");
+        if (file_ == nullptr) {
+            return;
+        }
+        char magic[sizeof(CAN_CAPTURE_MAGIC)];
+        binary_ = std::fread(magic, 1, sizeof(magic), file_) == sizeof(magic) &&
+                  std::memcmp(magic, CAN_CAPTURE_MAGIC, sizeof(magic)) == 0;
+        if (!binary_) {
+            std::rewind(file_);
+        }
+    }
+
+    ~CanCaptureReader() {
+        if (file_ != nullptr) {
+            std::fclose(file_);
+        }
+    }
+
+    CanCaptureReader(const CanCaptureReader&) = delete;
+    CanCaptureReader& operator=(const CanCaptureReader&) = delete;
+
+    [[nodiscard]] bool isOpen() const { return file_ != nullptr; }
+
+    void rewind() {
+        if (file_ != nullptr) {
+            std::fseek(file_, binary_ ? sizeof(CAN_CAPTURE_MAGIC) : 0, SEEK_SET);
+        }
+    }
+
+    /// Reads the next frame, returns false at the end of the capture
+    bool next(can_frame& frame, unsigned long long& timestamp) {
+        if (file_ == nullptr) {
+            return false;
+        }
+        if (binary_) {
+            uint8_t record[CAN_CAPTURE_RECORD_SIZE];
+            if (std::fread(record, 1, sizeof(record), file_) != sizeof(record)) {
+                return false;
+            }
+            frame = {};
+            timestamp = boost::endian::load_little_u64(record);
+            frame.can_id = boost::endian::load_little_u32(record + 8);
+            frame.can_dlc = record[12] > 8 ? 8 : record[12];
+            std::memcpy(frame.data, record + 16, 8);
+            return true;
+        }
+        char line[256];
+        while (std::fgets(line, sizeof(line), file_) != nullptr) {
+            if (parseCandumpLine(line, frame, timestamp)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    ///
+    /// Parses one candump -l line, e.g. "(1697040000.123456) can0 09F80123#0102030405060708". An 8 digit ID is an
+    /// extended frame, a 3 digit one a standard frame.
+    ///
+    static bool parseCandumpLine(const std::string_view line, can_frame& frame, unsigned long long& timestamp) {
+        if (line.empty() || line[0] != '(') {
+            return false;
+        }
+        const size_t dot = line.find('.');
+        const size_t close = line.find(')');
+        if (dot == std::string_view::npos || close == std::string_view::npos || dot > close) {
+            return false;
+        }
+        unsigned long long seconds = 0;
+        unsigned long long micros = 0;
+        if (std::from_chars(line.data() + 1, line.data() + dot, seconds).ec != std::errc{} ||
+            std::from_chars(line.data() + dot + 1, line.data() + close, micros).ec != std::errc{}) {
+            return false;
+        }
+        //Skip the interface name
+        const size_t idStart = line.find(' ', line.find_first_not_of(' ', close + 1));
+        const size_t hash = line.find('#', close);
+        if (idStart == std::string_view::npos || hash == std::string_view::npos || hash < idStart) {
+            return false;
+        }
+        const std::string_view id = line.substr(idStart + 1, hash - idStart - 1);
+        canid_t canId = 0;
+        if ((id.size() != 8 && id.size() != 3) ||
+            std::from_chars(id.data(), id.data() + id.size(), canId, 16).ec != std::errc{}) {
+            return false;
+        }
+        frame = {};
+        frame.can_id = id.size() == 8 ? (canId & CAN_EFF_MASK) | CAN_EFF_FLAG : canId & CAN_SFF_MASK;
+        size_t pos = hash + 1;
+        if (pos < line.size() && line[pos] == '#') {
+            //CAN FD frame
+            return false;
+        }
+        if (pos < line.size() && line[pos] == 'R') {
+            frame.can_id |= CAN_RTR_FLAG;
+        } else {
+            while (frame.can_dlc < 8 && pos + 1 < line.size() && std::isxdigit(line[pos]) && std::isxdigit(line[pos + 1])) {
+                std::from_chars(line.data() + pos, line.data() + pos + 2, frame.data[frame.can_dlc], 16);
+                frame.can_dlc++;
+                pos += 2;
+            }
+        }
+        timestamp = seconds * 1000000000ULL + micros * 1000;
+        return true;
+    }
+
+private:
+    std::FILE* file_ = nullptr;
+    bool binary_ = false;
+};
+
+#endif //CANCAPTURE_H
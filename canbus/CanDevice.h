@@ -1,36 +1,92 @@
 #ifndef CANDEVICE_H
 #define CANDEVICE_H
 
-#include <map>
+#include <cmath>
+#include <cstdint>
 #include <string>
-#include "../utils/TimeUtils.h"
+#include <vector>
 
 struct CanValueRecord {
+    uint64_t key;
     unsigned long long lastUpdate;
-    std::string value;
+    double value;
 };
 
-struct CanDevice {
-    bool updateValue(const std::string& propertyUid, const std:: string& instance, const std::string& value){
-        const std::string key = propertyUid + instance;
-        if(value.empty()){
-            return false;
+///
+/// Flat open addressed table of the last reported value for each (PGN, field, instance) of a device. Keys are packed
+/// into a single integer so a lookup is a hash and a handful of integer compares.
+///
+class PropertyValueStore {
+public:
+    static uint64_t makeKey(const uint32_t pgn, const uint8_t fieldIndex, const uint8_t instance) {
+        return static_cast<uint64_t>(pgn) << 16 | static_cast<uint64_t>(fieldIndex) << 8 | instance;
+    }
+
+    /// Returns the record for key, creating an empty one if it does not exist yet. inserted is set when it was created.
+    CanValueRecord& findOrInsert(const uint64_t key, bool& inserted) {
+        if ((size_ + 1) * 2 > slots_.size()) {
+            grow();
+        }
+        size_t slot = probe(key);
+        inserted = slots_[slot].key != key;
+        if (inserted) {
+            slots_[slot] = {.key = key, .lastUpdate = 0, .value = NAN};
+            size_++;
         }
-        if(!values.contains(key)){
-            values[key] = {.lastUpdate = systemTimeMillis(), .value = value};
-            return true;
+        return slots_[slot];
+    }
+
+    [[nodiscard]] size_t size() const { return size_; }
+
+private:
+    static constexpr uint64_t EMPTY_KEY = ~0ULL;
+    std::vector<CanValueRecord> slots_;
+    size_t size_ = 0;
+
+    [[nodiscard]] size_t probe(const uint64_t key) const {
+        const size_t mask = slots_.size() - 1;
+        size_t slot = (key * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+        while (slots_[slot].key != key && slots_[slot].key != EMPTY_KEY) {
+            slot = (slot + 1) & mask;
         }
-        if(value == values[key].value && systemTimeMillis() - values[key].lastUpdate < 5000){
-            return false;
+        return slot;
+    }
+
+    void grow() {
+        std::vector<CanValueRecord> old = std::move(slots_);
+        slots_.assign(old.empty() ? 64 : old.size() * 2, {.key = EMPTY_KEY, .lastUpdate = 0, .value = NAN});
+        for (const auto& record : old) {
+            if (record.key != EMPTY_KEY) {
+                slots_[probe(record.key)] = record;
+            }
+        }
+    }
+};
+
+struct CanDevice {
+    ///
+    /// Returns true when the value should be reported: it is new, it has moved more than deadband since it was last
+    /// reported, its availability changed, or heartbeatMs has passed since the last report.
+    ///
+    bool updateValue(const uint32_t pgn, const uint8_t fieldIndex, const uint8_t instance, const double value,
+                     const double deadband, const unsigned int heartbeatMs, const unsigned long long now) {
+        bool inserted;
+        CanValueRecord& record = values.findOrInsert(PropertyValueStore::makeKey(pgn, fieldIndex, instance), inserted);
+        if (!inserted) {
+            const bool unchanged = std::isnan(value) ? std::isnan(record.value) : std::abs(value - record.value) <= deadband;
+            if (unchanged && now - record.lastUpdate < heartbeatMs) {
+                return false;
+            }
         }
-        values[key] = {.lastUpdate = systemTimeMillis(), .value = value};
+        record.value = value;
+        record.lastUpdate = now;
         return true;
     }
 
     std::string uid = "";
     int address = -1;
     bool detailsInitialised = false;
-    std::map<std::string, CanValueRecord> values;
+    PropertyValueStore values;
 };
 
 
@@ -1,32 +1,52 @@
 #ifndef CANMESSAGE_H
 #define CANMESSAGE_H
 
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
 #include <map>
 #include <vector>
-#include <boost/dynamic_bitset.hpp>
+#include <boost/endian/conversion.hpp>
 #include "J1939Frame.h"
 #include "N2KProperty.h"
 #include "../utils/StringUtils.h"
 
+///
+/// A decoded field. value holds the scaled numeric value, or NaN when the field is not available on the bus or is not
+/// a numeric type; text holds the same value formatted for the string based consumers.
+///
+struct CanFieldValue {
+    const N2KProperty* property = nullptr;
+    const N2KDecodeStep* step = nullptr;
+    bool numeric = false;
+    double value = NAN;
+    std::string text{};
+};
+
 class CanMessage {
 public:
     CanMessage() = default;
 
-    explicit CanMessage(N2KContainer *property,
+    explicit CanMessage(const N2KContainer *property,
                         unsigned char length, unsigned char sequence, uint8_t source, uint8_t destination);
 
     void addToMessage(unsigned char frameNumber, J1939Frame &frame);
+    void setPayload(const uint8_t* data, uint8_t length);
 
     [[nodiscard]] bool isComplete() const;
 
     void populateFieldData();
 
-    std::map<std::string, std::string> stringMap();
+    [[nodiscard]] const std::vector<CanFieldValue>& fieldValues() const;
+    [[nodiscard]] std::map<std::string, std::string> stringMap() const;
     std::string pgn();
+    [[nodiscard]] uint32_t pgnNumber() const;
     [[nodiscard]] uint8_t source() const;
     [[nodiscard]] uint8_t destination() const;
     std::vector<uint8_t>data();
     std::string instance();
+    [[nodiscard]] uint8_t instanceId() const;
 
 private:
     bool singleFrame_ = false;
@@ -38,12 +58,13 @@ private:
     uint8_t nextExpectedFrame_ = 0;
     uint8_t sequence_ = 0;
     std::string instance_ = "";
+    uint8_t instanceId_ = 0;
     std::vector<uint8_t> messageBytes_ = {};
-    std::map<std::string, std::string> stringMap_ = {};
-    N2KContainer *propertyContainer_ = nullptr;
+    std::vector<CanFieldValue> fieldValues_ = {};
+    const N2KContainer *propertyContainer_ = nullptr;
 };
 
-inline CanMessage::CanMessage(N2KContainer *property, const unsigned char length, const unsigned char sequence,
+inline CanMessage::CanMessage(const N2KContainer *property, const unsigned char length, const unsigned char sequence,
     const uint8_t source, const uint8_t destination) {
     singleFrame_ = property->singleFrame;
     this->sequence_ = sequence;
@@ -83,304 +104,114 @@ inline void CanMessage::addToMessage(const unsigned char frameNumber, J1939Frame
     }
 }
 
+inline void CanMessage::setPayload(const uint8_t* data, const uint8_t length) {
+    messageBytes_.assign(data, data + length);
+    magic_ = length;
+}
+
 inline bool CanMessage::isComplete() const {
     return magic_ >= length_;
 }
 
-inline void CanMessage::populateFieldData() {
-    boost::dynamic_bitset<> bitset(length_ * 8);
-    for (int i = 0; i < length_; ++i) {
-        uint8_t cur = messageBytes_[i];
-        int offset = i * CHAR_BIT;
-        for (int bit = 0; bit < CHAR_BIT; ++bit) {
-            bitset[offset] = cur & 1;
-            ++offset;   // Move to next bit in b
-            cur >>= 1;  // Move to next bit in array
-        }
+///
+/// Pulls a single field out of the payload using little-endian word loads. Bytes past the end of the payload read
+/// as zero, so callers are expected to check the field is fully present first.
+///
+inline uint64_t extractBits(const uint8_t* bytes, const size_t size, const N2KDecodeStep& step) {
+    const size_t available = size - step.byteOffset;
+    uint64_t word = 0;
+    std::memcpy(&word, bytes + step.byteOffset, available < 8 ? available : 8);
+    uint64_t val = boost::endian::little_to_native(word) >> step.bitShift;
+    if (step.bitShift + step.bitLength > 64 && available > 8) {
+        val |= static_cast<uint64_t>(bytes[step.byteOffset + 8]) << (64 - step.bitShift);
     }
-    unsigned int cursor = 0;
-    for (const auto &field: propertyContainer_->fields) {
-        std::string value = "Not Available";
-        switch (stringHash(field.dataType.c_str())) {
-            case stringHash("string"):
-            case stringHash("String"):
+    return val & step.mask;
+}
+
+inline double scaledValue(const double raw, const N2KDecodeStep& step) {
+    const double dVal = step.scaled ? raw * step.multiplier + step.offset : raw + step.offset;
+    if (dVal < step.minVal || dVal > step.maxVal) {
+        return NAN;
+    }
+    return dVal;
+}
+
+inline void CanMessage::populateFieldData() {
+    const size_t payloadSize = std::min<size_t>(length_, messageBytes_.size());
+    fieldValues_.clear();
+    fieldValues_.reserve(propertyContainer_->decodePlan.size());
+    auto field = propertyContainer_->fields.cbegin();
+    for (const auto& step : propertyContainer_->decodePlan) {
+        CanFieldValue fv{.property = &*field, .step = &step};
+        const bool present = step.bitLength > 0 && step.byteOffset + (step.bitShift + step.bitLength + 7) / 8u <= payloadSize;
+        switch (step.type) {
+            case N2KFieldType::STRING:
                 //get string
+                fv.text = "Not Available";
                 break;
-            case stringHash("uint8"): {
-                uint8_t val = 0;
-                for (uint8_t i = 0; i < 8; i++) {
-                    if (bitset[i + cursor]) {
-                        val |= 1 << i;
-                    }
-                };
-                cursor += 8;
-                if (field.multiplier == 1 || field.multiplier == 0) {
-                    double dVal = val + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
-                } else {
-                    double dVal = val * field.multiplier + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
+            case N2KFieldType::UINT:
+                fv.numeric = true;
+                if (present) {
+                    fv.value = scaledValue(static_cast<double>(extractBits(messageBytes_.data(), payloadSize, step)), step);
                 }
                 break;
-            }
-            case stringHash("uint16"): {
-                uint16_t val = 0;
-                for (uint16_t i = 0; i < 16; i++) {
-                    if (bitset[i + cursor]) {
-                        val |= 1 << i;
-                    }
-                };
-                cursor += 16;
-                if (field.multiplier == 1 || field.multiplier == 0) {
-                    double dVal = val + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
-                } else {
-                    double dVal = val * field.multiplier + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
-                }
-                break;
-            }
-            case stringHash("uint32"): {
-                uint32_t val = 0;
-                for (uint32_t i = 0; i < 32; i++) {
-                    if (bitset[i + cursor]) {
-                        val |= 1 << i;
-                    }
-                };
-                cursor += 32;
-                if (field.multiplier == 1 || field.multiplier == 0) {
-                    double dVal = val + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
-                } else {
-                    double dVal = val * field.multiplier + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
+            case N2KFieldType::INT: {
+                fv.numeric = true;
+                if (!present) {
+                    break;
                 }
-                break;
-            }
-            case stringHash("uint64"): {
-                uint64_t val = 0;
-                for (uint16_t i = 0; i < 64; i++) {
-                    if (bitset[i + cursor]) {
-                        val |= 1 << i;
-                    }
-                };
-                cursor += 64;
-                if (field.multiplier == 1 || field.multiplier == 0) {
-                    long double dVal = static_cast<long double>(val) + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
-                } else {
-                    long double dVal = val * static_cast<long double>(field.multiplier) + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
+                uint64_t raw = extractBits(messageBytes_.data(), payloadSize, step);
+                if (step.bitLength < 64 && (raw >> (step.bitLength - 1)) & 1) {
+                    raw |= ~step.mask;
                 }
+                fv.value = scaledValue(static_cast<double>(static_cast<int64_t>(raw)), step);
                 break;
             }
-            case stringHash("int8"): {
-                int8_t val = 0;
-                for (int8_t i = 0; i < 8; i++) {
-                    if (bitset[i + cursor]) {
-                        val |= 1 << i;
-                    }
-                };
-                cursor += 8;
-                if (field.multiplier == 1 || field.multiplier == 0) {
-                    double dVal = val + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
-                } else {
-                    double dVal = val * field.multiplier + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
+            case N2KFieldType::FLOAT32:
+                fv.numeric = true;
+                if (present) {
+                    fv.value = scaledValue(std::bit_cast<float>(static_cast<uint32_t>(extractBits(messageBytes_.data(), payloadSize, step))), step);
                 }
                 break;
-            }
-            case stringHash("int16"): {
-                int16_t val = 0;
-                for (int16_t i = 0; i < 16; i++) {
-                    if (bitset[i + cursor]) {
-                        val |= 1 << i;
-                    }
-                };
-                cursor += 16;
-                if (field.multiplier == 1 || field.multiplier == 0) {
-                    double dVal = val + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
-                } else {
-                    double dVal = val * field.multiplier + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
+            case N2KFieldType::FLOAT64:
+                fv.numeric = true;
+                if (present) {
+                    fv.value = scaledValue(std::bit_cast<double>(extractBits(messageBytes_.data(), payloadSize, step)), step);
                 }
                 break;
-            }
-            case stringHash("int32"): {
-                int32_t val = 0;
-                for (int32_t i = 0; i < 32; i++) {
-                    if (bitset[i + cursor]) {
-                        val |= 1 << i;
-                    }
-                };
-                cursor += 32;
-                if (field.multiplier == 1 || field.multiplier == 0) {
-                    double dVal = val + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
-                } else {
-                    double dVal = val * field.multiplier + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
+            case N2KFieldType::BITFIELD:
+                fv.numeric = true;
+                if (present) {
+                    const uint64_t raw = extractBits(messageBytes_.data(), payloadSize, step);
+                    fv.value = static_cast<double>(raw);
+                    fv.text = std::to_string(raw);
                 }
                 break;
-            }
-            case stringHash("int64"): {
-                int64_t val = 0;
-                for (uint64_t i = 0; i < 64; i++) {
-                    if (bitset[i + cursor]) {
-                        val |= 1 << i;
-                    }
-                };
-                cursor += 64;
-                if (field.multiplier == 1 || field.multiplier == 0) {
-                    long double dVal = static_cast<long double>(val) + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
-                } else {
-                    long double dVal = static_cast<long double>(val) * field.multiplier + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
-                }
-                break;
-            }
-            case stringHash("float32"): {
-                uint32_t val = 0;
-                for (uint32_t i = 0; i < 32; i++) {
-                    if (bitset[i + cursor]) {
-                        val |= 1 << i;
-                    }
-                };
-                cursor += 32;
-                auto fVal = static_cast<float>(val);
-                if (field.multiplier == 1 || field.multiplier == 0) {
-                    double dVal = fVal + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
-                } else {
-                    double dVal = fVal * field.multiplier + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
-                }
-                break;
-            }
-            case stringHash("float64"): {
-                uint64_t val = 0;
-                for (uint64_t i = 0; i < 64; i++) {
-                    if (bitset[i + cursor]) {
-                        val |= 1 << i;
-                    }
-                };
-                cursor += 64;
-                auto fVal = static_cast<double>(val);
-                if (field.multiplier == 1 || field.multiplier == 0) {
-                    double dVal = fVal + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
-                } else {
-                    double dVal = fVal * field.multiplier + field.offset;
-                    if (dVal < field.minVal || dVal > field.maxVal) {
-                        value = "N/A";
-                    } else {
-                        value = std::to_string(dVal);
-                    }
-                }
-                break;
-            }
-            case stringHash("bitfield"): {
-                uint64_t val = 0;
-                for (uint32_t i = 0; i < field.bitLength; i++) {
-                    if (bitset[i + cursor]) {
-                        val |= 1 << i;
-                    }
-                };
-                cursor += field.bitLength;
-                value = std::to_string(val);
-                break;
-            }
             default:
-                value = "";
+                break;
+        }
+        if (fv.numeric && fv.text.empty()) {
+            fv.text = std::isnan(fv.value) ? "N/A" : std::to_string(fv.value);
         }
-        if (field.name.find("Instance") != std::string::npos) {
-            instance_ = value;
+        if (step.isInstance) {
+            instance_ = fv.text;
+            instanceId_ = std::isnan(fv.value) ? 0xFF : static_cast<uint8_t>(fv.value);
         }
-        stringMap_[field.uid] = value;
+        fieldValues_.push_back(std::move(fv));
+        ++field;
     }
 }
 
-inline std::map<std::string, std::string> CanMessage::stringMap() {
-    return stringMap_;
+inline const std::vector<CanFieldValue>& CanMessage::fieldValues() const {
+    return fieldValues_;
+}
+
+inline std::map<std::string, std::string> CanMessage::stringMap() const {
+    std::map<std::string, std::string> retMap;
+    for (const auto& fv : fieldValues_) {
+        retMap[fv.property->uid] = fv.text;
+    }
+    return retMap;
 }
 
 inline std::string CanMessage::pgn(){
@@ -399,8 +230,16 @@ inline std::vector<uint8_t> CanMessage::data(){
     return messageBytes_;
 }
 
+inline uint32_t CanMessage::pgnNumber() const {
+    return propertyContainer_ != nullptr ? propertyContainer_->pgn : 0;
+}
+
 inline std::string CanMessage::instance() {
     return instance_;
 }
 
+inline uint8_t CanMessage::instanceId() const {
+    return instanceId_;
+}
+
 #endif //CANMESSAGE_H
@@ -0,0 +1,55 @@
+#include "CanReplaySource.h"
+
+#include <boost/asio/post.hpp>
+#include "../logging/Logger.h"
+
+CanReplaySource::CanReplaySource(boost::asio::io_context& ioCtx, AsioCanSocket& socket, const std::string& path,
+                                 const double speed): ioCtx_(ioCtx), socket_(socket), reader_(path),
+                                 speed_(speed > 0 ? speed : 0), timer_(ioCtx) {
+    if (!reader_.isOpen()) {
+        Logger::instance().error("CanReplaySource", "Failed to open CAN capture " + path);
+        return;
+    }
+    if (!reader_.next(frame_, frameTimestamp_)) {
+        Logger::instance().warn("CanReplaySource", "CAN capture " + path + " has no frames");
+        return;
+    }
+    havePending_ = true;
+    captureStart_ = frameTimestamp_;
+    timestampOffset_ = duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count() - captureStart_;
+    replayStart_ = steady_clock::now();
+    Logger::instance().info("CanReplaySource", "Replaying " + path + (speed_ > 0 ? " at " + std::to_string(speed_) + "x" : " at full speed"));
+    boost::asio::post(ioCtx_, [this]() { step(); });
+}
+
+void CanReplaySource::step() {
+    for (size_t i = 0; i < CAN_REPLAY_BATCH; i++) {
+        if (!havePending_ && !(havePending_ = reader_.next(frame_, frameTimestamp_))) {
+            finish();
+            return;
+        }
+        if (speed_ > 0) {
+            const auto offset = static_cast<long long>((frameTimestamp_ - captureStart_) / speed_);
+            if (const auto due = replayStart_ + nanoseconds(offset); due > steady_clock::now()) {
+                timer_.expires_at(due);
+                timer_.async_wait([this](const boost::system::error_code& ec) {
+                    if (!ec) {
+                        step();
+                    }
+                });
+                return;
+            }
+        }
+        socket_.injectFrame(frame_, frameTimestamp_ + timestampOffset_);
+        havePending_ = false;
+        framesReplayed_++;
+    }
+    boost::asio::post(ioCtx_, [this]() { step(); });
+}
+
+void CanReplaySource::finish() {
+    const double seconds = duration_cast<microseconds>(steady_clock::now() - replayStart_).count() / 1e6;
+    Logger::instance().info("CanReplaySource", "Replay finished, " + std::to_string(framesReplayed_) + " frames in " +
+                            std::to_string(seconds) + "s (" +
+                            std::to_string(seconds > 0 ? framesReplayed_ / seconds : 0.0) + " frames/s)");
+}
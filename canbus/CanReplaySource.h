@@ -0,0 +1,41 @@
+#ifndef CANREPLAYSOURCE_H
+#define CANREPLAYSOURCE_H
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include "AsioCanSocket.h"
+#include "CanCapture.h"
+
+//Frames handed to the socket per turn of the io context, so a max speed replay does not starve everything else
+static constexpr size_t CAN_REPLAY_BATCH = 256;
+
+///
+/// Feeds a recorded capture through AsioCanSocket's receive path as if it had come off the bus. speed scales the gaps
+/// between frames: 1 is real time, 10 is ten times faster and 0 replays as fast as the decoder can go. Frame
+/// timestamps keep their recorded spacing whatever the speed, so fast packet reassembly sees exactly what it saw on
+/// the day and a replay always decodes the same way.
+///
+class CanReplaySource {
+public:
+    CanReplaySource(boost::asio::io_context& ioCtx, AsioCanSocket& socket, const std::string& path, double speed);
+
+private:
+    boost::asio::io_context& ioCtx_;
+    AsioCanSocket& socket_;
+    CanCaptureReader reader_;
+    double speed_;
+    boost::asio::steady_timer timer_;
+    can_frame frame_ = {};
+    unsigned long long frameTimestamp_ = 0;
+    bool havePending_ = false;
+    unsigned long long captureStart_ = 0;
+    //Moves capture timestamps onto the wall clock at the start of the replay
+    unsigned long long timestampOffset_ = 0;
+    steady_clock::time_point replayStart_;
+    unsigned long long framesReplayed_ = 0;
+
+    void step();
+    void finish();
+};
+
+#endif //CANREPLAYSOURCE_H
@@ -0,0 +1,162 @@
+#ifndef CANSTATISTICS_H
+#define CANSTATISTICS_H
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+static constexpr unsigned int DEFAULT_CAN_BITRATE = 250000;
+static constexpr size_t CAN_HISTOGRAM_BUCKETS = 24;
+
+///
+/// Power of two histogram of durations in microseconds. Bucket 0 counts anything under 1us and bucket i counts
+/// [2^(i-1), 2^i) us, with the last bucket catching everything longer.
+///
+using CanHistogram = std::array<unsigned long long, CAN_HISTOGRAM_BUCKETS>;
+
+inline void addToHistogram(CanHistogram& histogram, const unsigned long long micros) {
+    const size_t bucket = micros == 0 ? 0 : 64 - __builtin_clzll(micros);
+    histogram[std::min(bucket, CAN_HISTOGRAM_BUCKETS - 1)]++;
+}
+
+/// Upper bound in microseconds of the bucket holding the given fraction of samples, 0 when the histogram is empty
+inline unsigned long long histogramPercentile(const CanHistogram& histogram, const double fraction) {
+    unsigned long long total = 0;
+    for (const auto count : histogram) {
+        total += count;
+    }
+    if (total == 0) {
+        return 0;
+    }
+    const auto target = static_cast<unsigned long long>(total * fraction);
+    unsigned long long seen = 0;
+    for (size_t i = 0; i < CAN_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram[i];
+        if (seen > target) {
+            return 1ULL << i;
+        }
+    }
+    return 1ULL << (CAN_HISTOGRAM_BUCKETS - 1);
+}
+
+struct CanPgnStats {
+    uint32_t pgn = 0;
+    unsigned long long frames = 0;
+    unsigned long long messages = 0;
+    unsigned long long decodeNanos = 0;
+    unsigned long long decodeNanosMax = 0;
+};
+
+///
+/// Point in time copy of every CAN counter. All counters are totals since start up, rates come from the difference
+/// between two snapshots divided by the difference of their takenAt.
+///
+struct CanStatsSnapshot {
+    unsigned long long takenAt = 0;
+    unsigned long long rxFrames = 0;
+    unsigned long long rxBits = 0;
+    unsigned long long txFrames = 0;
+    unsigned long long txBits = 0;
+    unsigned long long rxOverflows = 0;
+    unsigned long long fastPacketCompleted = 0;
+    unsigned long long fastPacketTimedOut = 0;
+    unsigned long long fastPacketDropped = 0;
+    unsigned long long txQueueDropped = 0;
+    unsigned long long txCoalesced = 0;
+    unsigned long long txBudgetDeferrals = 0;
+    std::vector<CanPgnStats> pgns;
+    std::array<unsigned long long, 256> sourceFrames = {};
+    CanHistogram decodeTime = {};
+    CanHistogram latency = {};
+};
+
+///
+/// Counters for the CAN path. Everything is written from the io context, one short uncontended lock per frame, so
+/// snapshot() can be called from any thread without stopping the receive loop for longer than a copy.
+///
+class CanStatistics {
+public:
+    /// Bits an extended frame with dlc data bytes occupies on the wire, including interframe space but not stuffing
+    static constexpr unsigned int frameBits(const unsigned int dlc) {
+        return 67 + 8 * dlc;
+    }
+
+    void recordRx(const uint32_t pgn, const uint8_t source, const unsigned int dlc) {
+        std::lock_guard lock(lock_);
+        current_.rxFrames++;
+        current_.rxBits += frameBits(dlc);
+        current_.sourceFrames[source]++;
+        pgnStats(pgn).frames++;
+    }
+
+    void recordTx(const unsigned long long frames, const unsigned int dlc) {
+        std::lock_guard lock(lock_);
+        current_.txFrames += frames;
+        current_.txBits += frames * frameBits(dlc);
+    }
+
+    ///
+    /// Records a fully decoded message. decodeNanos is the time spent reassembling, decoding and dispatching it;
+    /// latencyNanos is how long after the kernel stamped the last frame we finished with it, 0 when unknown.
+    ///
+    void recordDecode(const uint32_t pgn, const unsigned long long decodeNanos, const unsigned long long latencyNanos) {
+        std::lock_guard lock(lock_);
+        CanPgnStats& stats = pgnStats(pgn);
+        stats.messages++;
+        stats.decodeNanos += decodeNanos;
+        stats.decodeNanosMax = std::max(stats.decodeNanosMax, decodeNanos);
+        addToHistogram(current_.decodeTime, decodeNanos / 1000);
+        if (latencyNanos != 0) {
+            addToHistogram(current_.latency, latencyNanos / 1000);
+        }
+    }
+
+    /// The kernel reports the total number of frames it has dropped for this socket, not a per-read count
+    void recordRxOverflow(const uint32_t totalDropped) {
+        std::lock_guard lock(lock_);
+        current_.rxOverflows = std::max<unsigned long long>(current_.rxOverflows, totalDropped);
+    }
+
+    void recordReassembly(const unsigned long long completed, const unsigned long long timedOut,
+                          const unsigned long long dropped) {
+        std::lock_guard lock(lock_);
+        current_.fastPacketCompleted = completed;
+        current_.fastPacketTimedOut = timedOut;
+        current_.fastPacketDropped = dropped;
+    }
+
+    [[nodiscard]] CanStatsSnapshot snapshot() {
+        CanStatsSnapshot out;
+        {
+            std::lock_guard lock(lock_);
+            out = current_;
+            out.pgns.reserve(pgns_.size());
+            for (const auto& [pgn, stats] : pgns_) {
+                out.pgns.push_back(stats);
+            }
+        }
+        out.takenAt = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        std::ranges::sort(out.pgns, [](const CanPgnStats& a, const CanPgnStats& b) { return a.pgn < b.pgn; });
+        return out;
+    }
+
+private:
+    std::mutex lock_;
+    CanStatsSnapshot current_;
+    std::unordered_map<uint32_t, CanPgnStats> pgns_;
+
+    CanPgnStats& pgnStats(const uint32_t pgn) {
+        auto it = pgns_.find(pgn);
+        if (it == pgns_.end()) {
+            it = pgns_.emplace(pgn, CanPgnStats{.pgn = pgn}).first;
+        }
+        return it->second;
+    }
+};
+
+#endif //CANSTATISTICS_H
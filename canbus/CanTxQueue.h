@@ -0,0 +1,76 @@
+#ifndef CANTXQUEUE_H
+#define CANTXQUEUE_H
+
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <linux/can.h>
+
+static constexpr size_t CAN_TX_QUEUE_SIZE = 512;
+
+///
+/// Ring of outgoing frames. The queue owns the frame storage, so a frame stays valid from the moment it is queued until
+/// the socket has taken it. Producers on any thread build their frames straight into the ring under the lock; the
+/// single consumer on the io context hands runs of queued frames to sendmmsg without copying them.
+///
+class CanTxQueue {
+public:
+    ///
+    /// Queues count frames as one unit, calling fill(frame, index) to build each in place. Either every frame is
+    /// queued or, when there is not room for all of them, none are, so a fast packet sequence is never cut short.
+    ///
+    template<typename F>
+    bool enqueue(const size_t count, F&& fill) {
+        std::lock_guard lock(lock_);
+        if (tail_ - head_ + count > CAN_TX_QUEUE_SIZE) {
+            dropped_ += count;
+            return false;
+        }
+        for (size_t i = 0; i < count; i++) {
+            fill(frames_[(tail_ + i) % CAN_TX_QUEUE_SIZE], i);
+        }
+        tail_ += count;
+        return true;
+    }
+
+    /// Returns the longest run of queued frames that is contiguous in memory, up to max, and its length
+    size_t peek(can_frame*& frames, const size_t max) {
+        std::lock_guard lock(lock_);
+        const size_t start = head_ % CAN_TX_QUEUE_SIZE;
+        size_t count = tail_ - head_;
+        if (count > CAN_TX_QUEUE_SIZE - start) {
+            count = CAN_TX_QUEUE_SIZE - start;
+        }
+        if (count > max) {
+            count = max;
+        }
+        frames = &frames_[start];
+        return count;
+    }
+
+    /// Releases the first count frames once the socket has taken them
+    void consume(const size_t count) {
+        std::lock_guard lock(lock_);
+        head_ += count;
+    }
+
+    [[nodiscard]] bool empty() {
+        std::lock_guard lock(lock_);
+        return head_ == tail_;
+    }
+
+    [[nodiscard]] unsigned long long dropped() {
+        std::lock_guard lock(lock_);
+        return dropped_;
+    }
+
+private:
+    std::mutex lock_;
+    std::array<can_frame, CAN_TX_QUEUE_SIZE> frames_ = {};
+    //Free running counters, the slot is the counter modulo the queue size
+    size_t head_ = 0;
+    size_t tail_ = 0;
+    unsigned long long dropped_ = 0;
+};
+
+#endif //CANTXQUEUE_H
@@ -0,0 +1,158 @@
+#ifndef CANTXSCHEDULER_H
+#define CANTXSCHEDULER_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include "FastPacketTable.h"
+
+static constexpr unsigned int DEFAULT_CAN_TX_BUDGET = 200;
+
+///
+/// The latest value waiting to go out for one (PGN, destination, stream). A newer value for the same slot replaces an
+/// unsent one, so a slow PGN only ever sends its freshest data. Stream keeps apart messages of one PGN that each carry
+/// different data rather than a newer version of the same, e.g. 129540 for each constellation.
+///
+struct CanTxSlot {
+    uint32_t pgn = 0;
+    uint8_t destination = 0;
+    uint8_t stream = 0;
+    uint8_t priority = 0;
+    unsigned int intervalMs = 0;
+    unsigned int frameCount = 0;
+    bool pending = false;
+    unsigned long long queuedAt = 0;
+    unsigned long long lastSent = 0;
+    size_t length = 0;
+    std::array<uint8_t, FAST_PACKET_MAX_PAYLOAD> payload = {};
+};
+
+///
+/// Decides when each outgoing PGN goes on the bus. Due PGNs are sent in priority order (0 highest) no more often than
+/// their interval, and all of them share a token bucket of framesPerSecond frames so we never take more than our share
+/// of a bus we have in common with the autopilot and engines.
+///
+class CanTxScheduler {
+public:
+    explicit CanTxScheduler(const unsigned int framesPerSecond = DEFAULT_CAN_TX_BUDGET):
+        framesPerSecond_(framesPerSecond > 0 ? framesPerSecond : DEFAULT_CAN_TX_BUDGET),
+        //A full fast packet has to fit in the bucket or it could never be sent
+        bucketSize_(std::max(framesPerSecond_ / 4.0, 32.0)),
+        tokens_(bucketSize_) {}
+
+    ///
+    /// Queues data for its slot, replacing anything still unsent there. Returns false, and queues nothing, when data is
+    /// larger than a fast packet can carry.
+    ///
+    bool submit(const uint32_t pgn, const uint8_t destination, const uint8_t stream, const uint8_t priority,
+                const unsigned int intervalMs, const unsigned int frameCount, const uint8_t* data, const size_t length,
+                const unsigned long long now) {
+        if (length > FAST_PACKET_MAX_PAYLOAD) {
+            return false;
+        }
+        std::lock_guard lock(lock_);
+        CanTxSlot& slot = findOrCreate(pgn, destination, stream);
+        if (slot.pending) {
+            coalesced_++;
+        } else {
+            slot.queuedAt = now;
+        }
+        slot.priority = priority;
+        slot.intervalMs = intervalMs;
+        slot.frameCount = frameCount;
+        slot.length = length;
+        std::memcpy(slot.payload.data(), data, length);
+        slot.pending = true;
+        return true;
+    }
+
+    ///
+    /// Calls send(slot) for every slot that is due at now, highest priority first, until the budget runs out. Returns
+    /// the number of milliseconds until something else could be sent, or -1 when nothing is waiting.
+    ///
+    template<typename F>
+    long long service(const unsigned long long now, F&& send) {
+        std::lock_guard lock(lock_);
+        refill(now);
+        due_.clear();
+        long long wait = -1;
+        for (auto& slot : slots_) {
+            if (!slot.pending) {
+                continue;
+            }
+            if (slot.lastSent != 0 && now - slot.lastSent < slot.intervalMs) {
+                const long long untilDue = static_cast<long long>(slot.lastSent + slot.intervalMs - now);
+                wait = wait < 0 ? untilDue : std::min(wait, untilDue);
+                continue;
+            }
+            due_.push_back(&slot);
+        }
+        std::ranges::sort(due_, [](const CanTxSlot* a, const CanTxSlot* b) {
+            return a->priority != b->priority ? a->priority < b->priority : a->queuedAt < b->queuedAt;
+        });
+        for (CanTxSlot* slot : due_) {
+            if (slot->frameCount > tokens_) {
+                //Out of budget, nothing of lower priority may jump the queue
+                const auto untilBudget = static_cast<long long>((slot->frameCount - tokens_) * 1000.0 / framesPerSecond_) + 1;
+                budgetDeferrals_++;
+                return wait < 0 ? untilBudget : std::min(wait, untilBudget);
+            }
+            tokens_ -= slot->frameCount;
+            send(*slot);
+            slot->pending = false;
+            slot->lastSent = now;
+            sent_++;
+        }
+        return wait;
+    }
+
+    [[nodiscard]] unsigned long long sent() {
+        std::lock_guard lock(lock_);
+        return sent_;
+    }
+    [[nodiscard]] unsigned long long coalesced() {
+        std::lock_guard lock(lock_);
+        return coalesced_;
+    }
+    [[nodiscard]] unsigned long long budgetDeferrals() {
+        std::lock_guard lock(lock_);
+        return budgetDeferrals_;
+    }
+
+private:
+    std::mutex lock_;
+    std::vector<CanTxSlot> slots_;
+    std::vector<CanTxSlot*> due_;
+    double framesPerSecond_;
+    double bucketSize_;
+    double tokens_;
+    unsigned long long lastRefill_ = 0;
+    unsigned long long sent_ = 0;
+    unsigned long long coalesced_ = 0;
+    unsigned long long budgetDeferrals_ = 0;
+
+    CanTxSlot& findOrCreate(const uint32_t pgn, const uint8_t destination, const uint8_t stream) {
+        for (auto& slot : slots_) {
+            if (slot.pgn == pgn && slot.destination == destination && slot.stream == stream) {
+                return slot;
+            }
+        }
+        slots_.emplace_back();
+        slots_.back().pgn = pgn;
+        slots_.back().destination = destination;
+        slots_.back().stream = stream;
+        return slots_.back();
+    }
+
+    void refill(const unsigned long long now) {
+        if (lastRefill_ != 0 && now > lastRefill_) {
+            tokens_ = std::min(bucketSize_, tokens_ + (now - lastRefill_) * framesPerSecond_ / 1000.0);
+        }
+        lastRefill_ = now;
+    }
+};
+
+#endif //CANTXSCHEDULER_H
@@ -0,0 +1,159 @@
+#ifndef FASTPACKETTABLE_H
+#define FASTPACKETTABLE_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include "J1939Frame.h"
+
+static constexpr size_t FAST_PACKET_MAX_PAYLOAD = 223;
+static constexpr size_t FAST_PACKET_SLOTS = 64;
+static constexpr unsigned long long FAST_PACKET_TIMEOUT_MS = 750;
+
+///
+/// A fast packet session holds one multi-frame message while it is being reassembled. Frames are copied straight
+/// into their final position in the payload, so they can arrive in any order. receivedFrames has a bit set for each
+/// frame number seen; once frame 0 has told us the length, expectedFrames holds the bits we need for completion.
+///
+struct FastPacketSession {
+    uint8_t source = 0;
+    uint8_t destination = 0;
+    uint8_t sequence = 0;
+    uint8_t length = 0;
+    uint32_t pgn = 0;
+    uint32_t receivedFrames = 0;
+    uint32_t expectedFrames = 0;
+    unsigned long long started = 0;
+    std::array<uint8_t, FAST_PACKET_MAX_PAYLOAD> payload = {};
+};
+
+///
+/// Fixed capacity reassembly table for NMEA 2000 fast packet PGNs. Sessions are keyed by source, PGN and sequence
+/// packed into a single integer and live in preallocated slots, so the per-frame path never touches the heap.
+/// Sessions that do not complete within FAST_PACKET_TIMEOUT_MS are evicted when a new session needs a slot.
+///
+class FastPacketTable {
+public:
+    FastPacketTable() {
+        keys_.fill(EMPTY_KEY);
+    }
+
+    /// Adds a frame to its session. Returns the session once every frame has been received, at which point the
+    /// caller owns it until release() is called. Returns nullptr while the message is still incomplete.
+    FastPacketSession* addFrame(J1939Frame& frame, const unsigned long long now) {
+        const uint8_t frameNo = frame.data()[0] & 0b00011111;
+        const uint8_t sequence = (frame.data()[0] & 0b11100000) >> 5;
+        const uint32_t key = packKey(frame.srcAddress(), frame.pgn(), sequence);
+
+        size_t slot = find(key);
+        if (slot != NO_SLOT && now - sessions_[slot].started > FAST_PACKET_TIMEOUT_MS) {
+            release(slot);
+            timedOut_++;
+            slot = NO_SLOT;
+        } else if (frameNo == 0 && slot != NO_SLOT && (sessions_[slot].receivedFrames & 1)) {
+            //Sequence counter has wrapped onto a session that never completed, start again
+            release(slot);
+            slot = NO_SLOT;
+        }
+        if (slot == NO_SLOT) {
+            slot = allocate(key, now);
+            FastPacketSession& session = sessions_[slot];
+            session.source = frame.srcAddress();
+            session.destination = frame.dstAddress();
+            session.sequence = sequence;
+            session.pgn = frame.pgn();
+        }
+
+        FastPacketSession& session = sessions_[slot];
+        if (frameNo == 0) {
+            const uint8_t length = frame.data()[1];
+            if (length > FAST_PACKET_MAX_PAYLOAD) {
+                release(slot);
+                dropped_++;
+                return nullptr;
+            }
+            session.length = length;
+            const unsigned int frameCount = length <= 6 ? 1 : 1 + (length - 6 + 6) / 7;
+            session.expectedFrames = frameCount >= 32 ? ~0U : (1U << frameCount) - 1;
+            std::memcpy(session.payload.data(), frame.data() + 2, 6);
+        } else {
+            const size_t offset = 6 + (frameNo - 1) * 7;
+            const size_t count = FAST_PACKET_MAX_PAYLOAD - offset < 7 ? FAST_PACKET_MAX_PAYLOAD - offset : 7;
+            std::memcpy(session.payload.data() + offset, frame.data() + 1, count);
+        }
+        session.receivedFrames |= 1U << frameNo;
+
+        if (session.expectedFrames != 0 && (session.receivedFrames & session.expectedFrames) == session.expectedFrames) {
+            completed_++;
+            return &session;
+        }
+        return nullptr;
+    }
+
+    void release(const FastPacketSession* session) {
+        release(static_cast<size_t>(session - sessions_.data()));
+    }
+
+    [[nodiscard]] unsigned long long completed() const { return completed_; }
+    [[nodiscard]] unsigned long long timedOut() const { return timedOut_; }
+    [[nodiscard]] unsigned long long dropped() const { return dropped_; }
+
+private:
+    static constexpr uint32_t EMPTY_KEY = 0xFFFFFFFF;
+    static constexpr size_t NO_SLOT = FAST_PACKET_SLOTS;
+
+    std::array<uint32_t, FAST_PACKET_SLOTS> keys_ = {};
+    std::array<FastPacketSession, FAST_PACKET_SLOTS> sessions_ = {};
+    unsigned long long completed_ = 0;
+    unsigned long long timedOut_ = 0;
+    unsigned long long dropped_ = 0;
+
+    static uint32_t packKey(const uint8_t source, const uint32_t pgn, const uint8_t sequence) {
+        return static_cast<uint32_t>(source) << 21 | (pgn & 0x3FFFF) << 3 | (sequence & 0x07);
+    }
+
+    [[nodiscard]] size_t find(const uint32_t key) const {
+        for (size_t i = 0; i < FAST_PACKET_SLOTS; i++) {
+            if (keys_[i] == key) {
+                return i;
+            }
+        }
+        return NO_SLOT;
+    }
+
+    size_t allocate(const uint32_t key, const unsigned long long now) {
+        size_t freeSlot = NO_SLOT;
+        size_t oldest = 0;
+        for (size_t i = 0; i < FAST_PACKET_SLOTS; i++) {
+            if (keys_[i] != EMPTY_KEY && now - sessions_[i].started > FAST_PACKET_TIMEOUT_MS) {
+                release(i);
+                timedOut_++;
+            }
+            if (keys_[i] == EMPTY_KEY) {
+                if (freeSlot == NO_SLOT) {
+                    freeSlot = i;
+                }
+            } else if (sessions_[i].started < sessions_[oldest].started) {
+                oldest = i;
+            }
+        }
+        if (freeSlot == NO_SLOT) {
+            //Table is full of live sessions, sacrifice the oldest
+            release(oldest);
+            dropped_++;
+            freeSlot = oldest;
+        }
+        keys_[freeSlot] = key;
+        sessions_[freeSlot].started = now;
+        return freeSlot;
+    }
+
+    void release(const size_t slot) {
+        keys_[slot] = EMPTY_KEY;
+        sessions_[slot].receivedFrames = 0;
+        sessions_[slot].expectedFrames = 0;
+        sessions_[slot].length = 0;
+    }
+};
+
+#endif //FASTPACKETTABLE_H
@@ -1,12 +1,14 @@
 #ifndef J1939FRAME_H
 #define J1939FRAME_H
 
+#include <algorithm>
 #include <iterator>
 #include <linux/can.h>
 
 class J1939Frame {
 public:
-    explicit J1939Frame(can_frame &frame) {
+    explicit J1939Frame(can_frame &frame, const unsigned long long timestamp = 0) {
+        timestamp_ = timestamp;
         const unsigned int canId = frame.can_id;
         priority_ = canId >> 26 & 0b111;
         dataPage_ = canId >> 24 & 0b1; //Feel the force Luke
@@ -38,6 +40,9 @@ public:
 
     unsigned char* data() { return data_; }
 
+    //Kernel receive time in nanoseconds since the epoch, 0 if the socket did not supply one
+    unsigned long long timestamp() const { return timestamp_; }
+
 private:
     unsigned char priority_;
     unsigned char srcAddress_;
@@ -47,5 +52,6 @@ private:
     unsigned char frameLength_;
     unsigned int pgn_;
     unsigned char data_[8];
+    unsigned long long timestamp_;
 };
 #endif //J1939FRAME_H
@@ -1,8 +1,13 @@
 #ifndef N2KPROPERTY_H
 #define N2KPROPERTY_H
+#include <cstdint>
 #include <list>
 #include <map>
 #include <string>
+#include <vector>
+
+//Unchanged values are re-reported at this interval unless the PGN database overrides it per field
+static constexpr unsigned int DEFAULT_HEARTBEAT_MS = 5000;
 
 struct N2KProperty {
     std::string name;
@@ -28,17 +33,53 @@ struct N2KProperty {
     std::string uid;
     std::string category;
     unsigned int bitLength;
+    double deadband;
+    unsigned int heartbeatInterval;
+};
+
+enum class N2KFieldType : uint8_t {
+    UNSUPPORTED = 0,
+    STRING,
+    UINT,
+    INT,
+    FLOAT32,
+    FLOAT64,
+    BITFIELD
+};
+
+///
+/// A decode step is the compiled form of an N2KProperty. It holds the position of the field within the reassembled
+/// payload and everything needed to turn the raw bits into a value, so the decoder never has to look at the
+/// property's strings. Steps are stored in field order, one per entry in N2KContainer::fields.
+///
+struct N2KDecodeStep {
+    uint16_t byteOffset = 0;
+    uint8_t bitShift = 0;
+    uint8_t bitLength = 0;
+    uint64_t mask = 0;
+    N2KFieldType type = N2KFieldType::UNSUPPORTED;
+    uint8_t fieldIndex = 0;
+    bool isInstance = false;
+    bool scaled = false;
+    double multiplier = 1;
+    double offset = 0;
+    double minVal = 0;
+    double maxVal = 0;
+    double deadband = 0;
+    unsigned int heartbeatMs = DEFAULT_HEARTBEAT_MS;
 };
 
 struct N2KContainer {
+    uint32_t pgn = 0;
     std::string name;
     std::string devicePropContainerKey;
     std::string description;
     bool singleFrame;
     bool destination;
     unsigned char defaultPriority;
-    unsigned char defaultUpdateRate;
+    unsigned int defaultUpdateRate; //Milliseconds between transmissions, 0 when the PGN is only sent on demand
     std::list<N2KProperty> fields;
     std::list<N2KProperty> repeatingFields;
+    std::vector<N2KDecodeStep> decodePlan;
 };
 #endif //N2KPROPERTY_H
@@ -1,4 +1,5 @@
 #include "N2KPropertyProvider.h"
+#include <charconv>
 #include <fstream>
 #include <iostream>
 #include <ranges>
@@ -6,16 +7,121 @@
 #include <string>
 #include <boost/json.hpp>
 #include "../logging/Logger.h"
+#include "../utils/StringUtils.h"
 
 namespace json = boost::json;
 
+static N2KFieldType fieldTypeFromString(const std::string& dataType, unsigned int& typeWidth) {
+    switch (stringHash(dataType.c_str())) {
+        case stringHash("string"):
+        case stringHash("String"):
+            typeWidth = 0;
+            return N2KFieldType::STRING;
+        case stringHash("uint8"):   typeWidth = 8;  return N2KFieldType::UINT;
+        case stringHash("uint16"):  typeWidth = 16; return N2KFieldType::UINT;
+        case stringHash("uint32"):  typeWidth = 32; return N2KFieldType::UINT;
+        case stringHash("uint64"):  typeWidth = 64; return N2KFieldType::UINT;
+        case stringHash("int8"):    typeWidth = 8;  return N2KFieldType::INT;
+        case stringHash("int16"):   typeWidth = 16; return N2KFieldType::INT;
+        case stringHash("int32"):   typeWidth = 32; return N2KFieldType::INT;
+        case stringHash("int64"):   typeWidth = 64; return N2KFieldType::INT;
+        case stringHash("float32"): typeWidth = 32; return N2KFieldType::FLOAT32;
+        case stringHash("float64"): typeWidth = 64; return N2KFieldType::FLOAT64;
+        case stringHash("bitfield"):
+            typeWidth = 0;
+            return N2KFieldType::BITFIELD;
+        default:
+            typeWidth = 0;
+            return N2KFieldType::UNSUPPORTED;
+    }
+}
+
+///
+/// Walks the field list once and records where each field sits in the payload. The field's Bytes/Bits from the PGN
+/// database define the layout; the width implied by the type name is only used when the database gives no size.
+///
+static void compileDecodePlan(N2KContainer& container) {
+    container.decodePlan.clear();
+    container.decodePlan.reserve(container.fields.size());
+    unsigned int cursor = 0;
+    for (const auto& field : container.fields) {
+        unsigned int typeWidth = 0;
+        N2KDecodeStep step;
+        step.type = fieldTypeFromString(field.dataType, typeWidth);
+        const unsigned int bitLength = field.bitLength != 0 ? field.bitLength : typeWidth;
+        step.byteOffset = cursor / 8;
+        step.bitShift = cursor % 8;
+        if (step.type != N2KFieldType::STRING && bitLength > 64) {
+            Logger::instance().warn("N2KPropertyProvider", "Field " + field.uid + " is wider than 64 bits, skipping");
+            step.type = N2KFieldType::UNSUPPORTED;
+        }
+        step.bitLength = bitLength > 64 ? 64 : bitLength;
+        step.mask = step.bitLength >= 64 ? ~0ULL : (1ULL << step.bitLength) - 1;
+        step.isInstance = field.name.find("Instance") != std::string::npos;
+        step.scaled = field.multiplier != 1 && field.multiplier != 0;
+        step.multiplier = field.multiplier;
+        step.offset = field.offset;
+        step.minVal = field.minVal;
+        step.maxVal = field.maxVal;
+        step.fieldIndex = container.decodePlan.size();
+        step.deadband = field.deadband;
+        step.heartbeatMs = field.heartbeatInterval != 0 ? field.heartbeatInterval : DEFAULT_HEARTBEAT_MS;
+        container.decodePlan.push_back(step);
+        cursor += bitLength;
+    }
+}
+
 void N2KPropertyProvider::addPropertyContainer(const N2KContainer& container) {
-    n2kContainers_[container.devicePropContainerKey] = container;
+    if(insertContainer(container)) {
+        rebuildIndex();
+    }
+}
+
+bool N2KPropertyProvider::insertContainer(const N2KContainer& container) {
+    const std::string& key = container.devicePropContainerKey;
+    uint32_t pgn = 0;
+    if(const auto [end, ec] = std::from_chars(key.data(), key.data() + key.size(), pgn);
+       ec != std::errc{} || end != key.data() + key.size()) {
+        Logger::instance().warn("N2KPropertyProvider", "Skipping PGN definition with invalid key '" + key + "'");
+        return false;
+    }
+    auto& stored = n2kContainers_[pgn];
+    stored = container;
+    stored.pgn = pgn;
+    compileDecodePlan(stored);
+    return true;
+}
+
+size_t N2KPropertyProvider::indexHash(const uint32_t pgn) const {
+    return (pgn * 2654435761u) >> (32 - indexBits_);
+}
+
+void N2KPropertyProvider::rebuildIndex() {
+    //Keep the table at most a quarter full so probes are almost always a single hit
+    indexBits_ = 4;
+    while((1u << indexBits_) < n2kContainers_.size() * 4) {
+        indexBits_++;
+    }
+    index_.assign(1u << indexBits_, IndexSlot{});
+    const size_t mask = index_.size() - 1;
+    for(const auto& [pgn, container] : n2kContainers_){
+        size_t slot = indexHash(pgn);
+        while(index_[slot].container != nullptr) {
+            slot = (slot + 1) & mask;
+        }
+        index_[slot] = {pgn, &container};
+    }
 }
 
-std::shared_ptr<N2KContainer> N2KPropertyProvider::getPropertyContainer(const std::string& uid) {
-    if(n2kContainers_.contains(uid)){
-        return std::make_shared<N2KContainer>(n2kContainers_[uid]);
+const N2KContainer* N2KPropertyProvider::getPropertyContainer(const uint32_t pgn) const {
+    if(index_.empty()){
+        return nullptr;
+    }
+    const size_t mask = index_.size() - 1;
+    for(size_t slot = indexHash(pgn); index_[slot].container != nullptr; slot = (slot + 1) & mask){
+        if(index_[slot].pgn == pgn){
+            return index_[slot].container;
+        }
     }
     return nullptr;
 }
@@ -30,6 +136,15 @@ std::list<N2KProperty> N2KPropertyProvider::findAllProperties() const {
     return retList;
 }
 
+std::vector<uint32_t> N2KPropertyProvider::pgns() const {
+    std::vector<uint32_t> retList;
+    retList.reserve(n2kContainers_.size());
+    for(const auto& key : n2kContainers_ | std::views::keys){
+        retList.push_back(key);
+    }
+    return retList;
+}
+
 std::shared_ptr<N2KProperty> N2KPropertyProvider::findN2KPropertyByUid(const std::string& uid) const {
     for(const auto& val : n2kContainers_ | std::views::values){
         for(auto const& p : val.fields){
@@ -132,7 +247,9 @@ void N2KPropertyProvider::loadProperties() {
         dpc.singleFrame = get_bool("SingleFrame");
         dpc.destination = get_bool("Destination");
         dpc.defaultPriority = get_u32("DefaultPriority");
-        dpc.defaultUpdateRate = get_u64("DefaultUpdateRate");
+        //The database mixes milliseconds and nanoseconds, nothing is sent less often than every 1000 seconds
+        const std::uint64_t updateRate = get_u64("DefaultUpdateRate");
+        dpc.defaultUpdateRate = static_cast<unsigned int>(updateRate >= 1000000 ? updateRate / 1000000 : updateRate);
 
         if (auto* fieldsVal = obj.if_contains("Fields"); fieldsVal && fieldsVal->is_array()) {
             const json::array& fields = fieldsVal->as_array();
@@ -213,11 +330,14 @@ void N2KPropertyProvider::loadProperties() {
                 dp.category = get_prop_str("category");
                 dp.persistProperty = get_prop_bool("persistProperty");
                 dp.instantReport = get_prop_bool("instantReport");
+                dp.deadband = get_prop_double("deadband");
+                dp.heartbeatInterval = get_prop_u32("heartbeatInterval");
 
                 dpc.fields.push_back(std::move(dp));
             }
         }
-        Logger::instance().trace("N2KPropertyProvider", "Adding PGN " + dpc.devicePropContainerKey);
-        addPropertyContainer(dpc);
+        LOG_TRACE("N2KPropertyProvider", "Adding PGN " + dpc.devicePropContainerKey);
+        insertContainer(dpc);
     }
+    rebuildIndex();
 }
@@ -3,6 +3,7 @@
 #include <fstream>
 #include <map>
 #include <memory>
+#include <vector>
 #include "N2KProperty.h"
 
 class N2KPropertyProvider {
@@ -12,8 +13,9 @@ public:
         return instance;
     }
     void addPropertyContainer(const N2KContainer&);
-    std::shared_ptr<N2KContainer> getPropertyContainer(const std::string& uid);
+    [[nodiscard]] const N2KContainer* getPropertyContainer(uint32_t pgn) const;
     std::list<N2KProperty> findAllProperties() const;
+    std::vector<uint32_t> pgns() const;
     std::shared_ptr<N2KProperty> findN2KPropertyByUid(const std::string& uid) const;
     void loadProperties();
 
@@ -23,7 +25,22 @@ public:
     N2KPropertyProvider& operator= (const N2KPropertyProvider&& other) = delete;
 private:
     N2KPropertyProvider()= default;
-    std::map<std::string, N2KContainer> n2kContainers_ = {};
+
+    ///
+    /// Open addressed lookup table from PGN to container, rebuilt once the PGN database has loaded and whenever a
+    /// container is added on its own. It is only written at startup, after which lookups are lock and allocation free.
+    ///
+    struct IndexSlot {
+        uint32_t pgn = 0;
+        const N2KContainer* container = nullptr;
+    };
+    bool insertContainer(const N2KContainer& container);
+    void rebuildIndex();
+    [[nodiscard]] size_t indexHash(uint32_t pgn) const;
+
+    std::map<uint32_t, N2KContainer> n2kContainers_ = {};
+    std::vector<IndexSlot> index_ = {};
+    unsigned int indexBits_ = 0;
 };
 
 
@@ -29,8 +29,56 @@ void ConfigProvider::loadConfig(const std::string& filePath) {
     assetName_ = value_to<std::string>(obj.at("assetName"));
     riedelBoatNumber_ = value_to<int>(obj.at("riedelBoatNumber"));
     serialPort_ = value_to<std::string>(obj.at("serialPort"));
+    if (obj.contains("gnssProtocol")) {
+        gnssProtocol_ = value_to<std::string>(obj.at("gnssProtocol"));
+    }
+    if (obj.contains("gnssRate")) {
+        gnssRate_ = value_to<int>(obj.at("gnssRate"));
+    }
+    if (obj.contains("rtcmSource")) {
+        rtcmSource_ = value_to<std::string>(obj.at("rtcmSource"));
+    }
+    if (obj.contains("rtcmMaxAge")) {
+        rtcmMaxAge_ = value_to<int>(obj.at("rtcmMaxAge"));
+    }
+    if (obj.contains("positionPublishMode")) {
+        positionPublishMode_ = value_to<std::string>(obj.at("positionPublishMode"));
+    }
+    if (obj.contains("positionMaxRate")) {
+        positionMaxRate_ = value_to<int>(obj.at("positionMaxRate"));
+    }
+    if (obj.contains("positionFixTimeout")) {
+        positionFixTimeout_ = value_to<int>(obj.at("positionFixTimeout"));
+    }
+    if (obj.contains("positionFilter")) {
+        positionFilter_ = value_to<bool>(obj.at("positionFilter"));
+    }
+    if (obj.contains("positionOutputRate")) {
+        positionOutputRate_ = value_to<int>(obj.at("positionOutputRate"));
+    }
     influxAddress_ = value_to<std::string>(obj.at("influxAddress"));
+    if (obj.contains("influxBucket")) {
+        influxBucket_ = value_to<std::string>(obj.at("influxBucket"));
+    }
+    if (obj.contains("influxOrg")) {
+        influxOrg_ = value_to<std::string>(obj.at("influxOrg"));
+    }
+    if (obj.contains("influxToken")) {
+        influxToken_ = value_to<std::string>(obj.at("influxToken"));
+    }
+    if (obj.contains("influxBatchSize")) {
+        influxBatchSize_ = value_to<int>(obj.at("influxBatchSize"));
+    }
+    if (obj.contains("influxFlushInterval")) {
+        influxFlushInterval_ = value_to<int>(obj.at("influxFlushInterval"));
+    }
     mdssAddress_ = value_to<std::string>(obj.at("mdssAddress"));
+    if (obj.contains("mdssPort")) {
+        mdssPort_ = value_to<int>(obj.at("mdssPort"));
+    }
+    if (obj.contains("mdssRate")) {
+        mdssRate_ = value_to<int>(obj.at("mdssRate"));
+    }
     plotterAddress_ = value_to<std::string>(obj.at("plotterAddress"));
 
     nmeaPgnFilter_.clear();
@@ -38,6 +86,40 @@ void ConfigProvider::loadConfig(const std::string& filePath) {
         nmeaPgnFilter_.push_back(value_to<int>(v));
     }
 
+    if (obj.contains("canInterface")) {
+        canInterface_ = value_to<std::string>(obj.at("canInterface"));
+    }
+    if (obj.contains("canTxBudget")) {
+        canTxBudget_ = value_to<int>(obj.at("canTxBudget"));
+    }
+    if (obj.contains("canBitrate")) {
+        canBitrate_ = value_to<int>(obj.at("canBitrate"));
+    }
+    if (obj.contains("canStatsInterval")) {
+        canStatsInterval_ = value_to<int>(obj.at("canStatsInterval"));
+    }
+    if (obj.contains("canCaptureFile")) {
+        canCaptureFile_ = value_to<std::string>(obj.at("canCaptureFile"));
+    }
+    if (obj.contains("canCaptureFormat")) {
+        canCaptureFormat_ = value_to<std::string>(obj.at("canCaptureFormat"));
+    }
+    if (obj.contains("canReplayFile")) {
+        canReplayFile_ = value_to<std::string>(obj.at("canReplayFile"));
+    }
+    if (obj.contains("canReplaySpeed")) {
+        canReplaySpeed_ = value_to<double>(obj.at("canReplaySpeed"));
+    }
+    if (obj.contains("telemetrySpoolDir")) {
+        telemetrySpoolDir_ = value_to<std::string>(obj.at("telemetrySpoolDir"));
+    }
+    if (obj.contains("telemetrySpoolSegmentSize")) {
+        telemetrySpoolSegmentSize_ = value_to<int>(obj.at("telemetrySpoolSegmentSize"));
+    }
+    if (obj.contains("telemetrySpoolLimit")) {
+        telemetrySpoolLimit_ = value_to<int>(obj.at("telemetrySpoolLimit"));
+    }
+
     nmeaInstanceMapping_.clear();
     const object& pgnMap = obj.at("nmeaInstanceMapping").as_object();
 
@@ -67,14 +149,78 @@ const std::string& ConfigProvider::serialPort() const {
     return serialPort_;
 }
 
+const std::string& ConfigProvider::gnssProtocol() const {
+    return gnssProtocol_;
+}
+
+int ConfigProvider::gnssRate() const {
+    return gnssRate_;
+}
+
+const std::string& ConfigProvider::rtcmSource() const {
+    return rtcmSource_;
+}
+
+int ConfigProvider::rtcmMaxAge() const {
+    return rtcmMaxAge_;
+}
+
+const std::string& ConfigProvider::positionPublishMode() const {
+    return positionPublishMode_;
+}
+
+int ConfigProvider::positionMaxRate() const {
+    return positionMaxRate_;
+}
+
+int ConfigProvider::positionFixTimeout() const {
+    return positionFixTimeout_;
+}
+
+bool ConfigProvider::positionFilter() const {
+    return positionFilter_;
+}
+
+int ConfigProvider::positionOutputRate() const {
+    return positionOutputRate_;
+}
+
 const std::string& ConfigProvider::influxAddress() const {
     return influxAddress_;
 }
 
+const std::string& ConfigProvider::influxBucket() const {
+    return influxBucket_;
+}
+
+const std::string& ConfigProvider::influxOrg() const {
+    return influxOrg_;
+}
+
+const std::string& ConfigProvider::influxToken() const {
+    return influxToken_;
+}
+
+int ConfigProvider::influxBatchSize() const {
+    return influxBatchSize_;
+}
+
+int ConfigProvider::influxFlushInterval() const {
+    return influxFlushInterval_;
+}
+
 const std::string& ConfigProvider::mdssAddress() const {
     return mdssAddress_;
 }
 
+int ConfigProvider::mdssPort() const {
+    return mdssPort_;
+}
+
+int ConfigProvider::mdssRate() const {
+    return mdssRate_;
+}
+
 const std::string& ConfigProvider::plotterAddress() const {
     return plotterAddress_;
 }
@@ -83,6 +229,50 @@ const std::vector<int>& ConfigProvider::nmeaPgnFilter() const {
     return nmeaPgnFilter_;
 }
 
+const std::string& ConfigProvider::canInterface() const {
+    return canInterface_;
+}
+
+int ConfigProvider::canTxBudget() const {
+    return canTxBudget_;
+}
+
+int ConfigProvider::canBitrate() const {
+    return canBitrate_;
+}
+
+int ConfigProvider::canStatsInterval() const {
+    return canStatsInterval_;
+}
+
+const std::string& ConfigProvider::canCaptureFile() const {
+    return canCaptureFile_;
+}
+
+const std::string& ConfigProvider::canCaptureFormat() const {
+    return canCaptureFormat_;
+}
+
+const std::string& ConfigProvider::canReplayFile() const {
+    return canReplayFile_;
+}
+
+double ConfigProvider::canReplaySpeed() const {
+    return canReplaySpeed_;
+}
+
+const std::string& ConfigProvider::telemetrySpoolDir() const {
+    return telemetrySpoolDir_;
+}
+
+int ConfigProvider::telemetrySpoolSegmentSize() const {
+    return telemetrySpoolSegmentSize_;
+}
+
+int ConfigProvider::telemetrySpoolLimit() const {
+    return telemetrySpoolLimit_;
+}
+
 const std::unordered_map<int,
     std::unordered_map<int, std::string>>&
 ConfigProvider::nmeaInstanceMapping() const {
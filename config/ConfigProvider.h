@@ -14,10 +14,37 @@ public:
     const std::string& assetName() const;
     int riedelBoatNumber() const;
     const std::string& serialPort() const;
+    const std::string& gnssProtocol() const;
+    int gnssRate() const;
+    const std::string& rtcmSource() const;
+    int rtcmMaxAge() const;
+    const std::string& positionPublishMode() const;
+    int positionMaxRate() const;
+    int positionFixTimeout() const;
+    bool positionFilter() const;
+    int positionOutputRate() const;
     const std::string& influxAddress() const;
+    const std::string& influxBucket() const;
+    const std::string& influxOrg() const;
+    const std::string& influxToken() const;
+    int influxBatchSize() const;
+    int influxFlushInterval() const;
     const std::string& mdssAddress() const;
+    int mdssPort() const;
+    int mdssRate() const;
     const std::string& plotterAddress() const;
     const std::vector<int>& nmeaPgnFilter() const;
+    const std::string& canInterface() const;
+    int canTxBudget() const;
+    int canBitrate() const;
+    int canStatsInterval() const;
+    const std::string& canCaptureFile() const;
+    const std::string& canCaptureFormat() const;
+    const std::string& canReplayFile() const;
+    double canReplaySpeed() const;
+    const std::string& telemetrySpoolDir() const;
+    int telemetrySpoolSegmentSize() const;
+    int telemetrySpoolLimit() const;
 
     const std::unordered_map<int,
         std::unordered_map<int, std::string>>& nmeaInstanceMapping() const;
@@ -30,10 +57,37 @@ private:
     std::string assetName_;
     int riedelBoatNumber_{0};
     std::string serialPort_;
+    std::string gnssProtocol_ = "NMEA";
+    int gnssRate_{0};
+    std::string rtcmSource_;
+    int rtcmMaxAge_{2000};
+    std::string positionPublishMode_ = "EPOCH";
+    int positionMaxRate_{10};
+    int positionFixTimeout_{2000};
+    bool positionFilter_{false};
+    int positionOutputRate_{0};
     std::string influxAddress_;
+    std::string influxBucket_ = "telemetry";
+    std::string influxOrg_;
+    std::string influxToken_;
+    int influxBatchSize_{65536};
+    int influxFlushInterval_{1000};
     std::string mdssAddress_;
+    int mdssPort_{5005};
+    int mdssRate_{5};
     std::string plotterAddress_;
     std::vector<int> nmeaPgnFilter_;
+    std::string canInterface_ = "can0";
+    int canTxBudget_{200};
+    int canBitrate_{250000};
+    int canStatsInterval_{60};
+    std::string canCaptureFile_;
+    std::string canCaptureFormat_ = "CANDUMP";
+    std::string canReplayFile_;
+    double canReplaySpeed_{1.0};
+    std::string telemetrySpoolDir_ = "telemetry-spool";
+    int telemetrySpoolSegmentSize_{16};
+    int telemetrySpoolLimit_{1024};
 
     std::unordered_map<int,
         std::unordered_map<int, std::string>> nmeaInstanceMapping_;
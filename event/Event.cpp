@@ -6,19 +6,23 @@ PropertyRecord::PropertyRecord(const std::string &propertyUid, const std::string
     this->value = value;
 }
 
-NMEAPropertyEvent::NMEAPropertyEvent(const std::string& deviceUid) {
+NMEAPropertyEvent::NMEAPropertyEvent() {
     eventType_ = EventType::NMEA_PROPERTY;
-    this->deviceUid = deviceUid;
 }
 
 void NMEAPropertyEvent::addValue(const std::string& propertyUid, const std::string& instance, const std::string& value) {
     values_.emplace_back(propertyUid, instance, value);
 }
 
-std::vector<PropertyRecord> NMEAPropertyEvent::values(){
+const std::vector<PropertyRecord>& NMEAPropertyEvent::values() const {
     return values_;
 }
 
+void NMEAPropertyEvent::reset() {
+    deviceUid.clear();
+    values_.clear();
+}
+
 GNSSPositionEvent::GNSSPositionEvent() {
     eventType_ = EventType::GNSS_POSITION;
 }
@@ -26,3 +30,16 @@ GNSSPositionEvent::GNSSPositionEvent() {
 GNSSSatellitesEvent::GNSSSatellitesEvent() {
     eventType_ = EventType::GNSS_SATELLITES;
 }
+
+void GNSSSatellitesEvent::reset() {
+    satsInView = 0;
+    satellites.clear();
+    constellation = GNSSSatelliteConstellation::GPS;
+    source = USB;
+}
+
+void RTKCorrectionEvent::reset() {
+    messageType = 0;
+    received = 0;
+    frame.clear();
+}
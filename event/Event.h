@@ -1,6 +1,8 @@
 #ifndef EVENT_H
 #define EVENT_H
+#include <atomic>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <vector>
 
@@ -36,17 +38,49 @@ enum GNSSSatelliteConstellation {
     COMBINED
 };
 
+enum GNSSFixQuality {
+    FIX_UNKNOWN = 0,
+    FIX_DEAD_RECKONING,
+    FIX_GNSS,
+    FIX_DGNSS,
+    FIX_RTK_FLOAT,
+    FIX_RTK_FIXED
+};
+
+enum SourceSelectionReason {
+    SELECTION_NONE = 0,
+    SELECTION_INITIAL,
+    SELECTION_FAILOVER,
+    SELECTION_BETTER_ACCURACY
+};
+
 enum RAGStatus {
     RED = 0,
     AMBER,
     GREEN
 };
 
+///
+/// Base for all events. Events are recycled through EventPool rather than freed; the bookkeeping used by the pool and
+/// the dispatcher is deliberately left out of copies so a pooled event can be reset with a plain assignment.
+///
 struct Event {
+    Event() = default;
+    Event(const Event& other) : eventType_(other.eventType_) {}
+    Event& operator=(const Event& other) {
+        eventType_ = other.eventType_;
+        return *this;
+    }
     virtual ~Event() = default;
     EventType eventType() const {return eventType_;};
 protected:
     EventType eventType_ = NONE;
+private:
+    friend class EventDispatcher;
+    template<typename T> friend class EventPool;
+    friend void releaseEvent(Event* ev);
+    std::atomic<uint32_t> pendingDeliveries_ = 0;
+    void (*recycle_)(Event*) = nullptr;
 };
 ///
 /// Property records represent an individual value instance for a NMEA property
@@ -62,10 +96,12 @@ struct PropertyRecord {
 /// as presented by the bus, with dictionaries applied where necessary
 ///
 struct NMEAPropertyEvent final: Event {
-    explicit NMEAPropertyEvent(const std::string& deviceUid);
+    static constexpr EventType TYPE = NMEA_PROPERTY;
+    NMEAPropertyEvent();
     std::string deviceUid;
-    std::vector<PropertyRecord> values();
+    [[nodiscard]] const std::vector<PropertyRecord>& values() const;
     void addValue(const std::string& propertyUid, const std::string& instance, const std::string& value);
+    void reset();
 private:
     std::vector<PropertyRecord> values_;
 };
@@ -74,6 +110,7 @@ private:
 /// and the fields vector should contain the full list of fields used in the PGN
 ///
 struct NMEAPGNEvent final: Event {
+    static constexpr EventType TYPE = NMEA_BUS;
     NMEAPGNEvent();
     std::string pgn;
     std::vector<std::string> values;
@@ -84,17 +121,21 @@ struct NMEAPGNEvent final: Event {
 /// location provider for processing. The location provider then sends these to the relevant outputs (N2K, MDSS, influx)
 ///
 struct GNSSPositionEvent final : Event {
+    static constexpr EventType TYPE = GNSS_POSITION;
     GNSSPositionEvent();
     double latitude = NAN;
     double longitude = NAN;
     double altitude = NAN;
     double hAccuracy = NAN;
     double vAccuracy = NAN;
-    double speed = NAN;
+    double speed = NAN; //Speed over ground in m/s, whatever unit the source sentence uses
     double heading = NAN;
     double vVelocity = NAN;
     double correctionAge = NAN;
     double hdop = NAN;
+    double timeOfFix = NAN; //UTC seconds since midnight, NaN when the sentence does not carry one
+    bool epochComplete = false; //Set when this event alone carries the whole fix for its epoch, e.g. NAV-PVT
+    GNSSFixQuality fixQuality = FIX_UNKNOWN;
     GNSSSatelliteConstellation constellation = UNKNOWN;
     GNSSSource source = USB;
 };
@@ -109,7 +150,9 @@ struct GNSSSatelliteRecord {
 };
 
 struct GNSSSatellitesEvent final : Event {
+    static constexpr EventType TYPE = GNSS_SATELLITES;
     GNSSSatellitesEvent();
+    void reset();
     unsigned int satsInView = 0;
     std::vector<GNSSSatelliteRecord> satellites;
     GNSSSatelliteConstellation constellation = GNSSSatelliteConstellation::GPS;
@@ -117,33 +160,54 @@ struct GNSSSatellitesEvent final : Event {
 };
 
 struct GNSSTodEvent final: Event {
-
+    static constexpr EventType TYPE = GNSS_TOD;
+    GNSSTodEvent() {eventType_ = TYPE;};
+    unsigned long long timestamp = 0; //UTC milliseconds since the Unix epoch
+    double accuracy = NAN; //Seconds
+    GNSSSource source = USB;
 };
 
+///
+/// One CRC checked RTCM3 message on its way from a correction source to the receiver
+///
 struct RTKCorrectionEvent final: Event {
-
+    static constexpr EventType TYPE = RTK_CORRECTION;
+    RTKCorrectionEvent() {eventType_ = TYPE;};
+    void reset();
+    uint16_t messageType = 0;
+    unsigned long long received = 0; //UTC milliseconds since the Unix epoch when the message arrived
+    std::vector<uint8_t> frame; //The whole message, preamble to CRC
 };
 
 struct CourseUpdateEvent final: Event {
-
+    static constexpr EventType TYPE = COURSE_UPDATE;
+    CourseUpdateEvent() {eventType_ = TYPE;};
 };
 
 struct AssetPositionEvent final: Event {
-
+    static constexpr EventType TYPE = ASSET_POSITION;
+    AssetPositionEvent() {eventType_ = TYPE;};
 };
 
 struct RAGStatusEvent final: Event {
-
+    static constexpr EventType TYPE = RAG_STATUS;
+    RAGStatusEvent() {eventType_ = TYPE;};
 };
 
 struct CommitteeMessageEvent final: Event {
-
+    static constexpr EventType TYPE = COMMITTEE_MESSAGE;
+    CommitteeMessageEvent() {eventType_ = TYPE;};
 };
 
 ///
 /// Position events are sent by the location provider to be consumed by influx, mdss, n2k
 struct PositionEvent final: Event {
-    PositionEvent() {eventType_ = POSITION;};
+    static constexpr EventType TYPE = POSITION;
+    PositionEvent() {eventType_ = TYPE;};
+    bool fixValid = true; //False when the location provider has lost its fix, all values are then NaN
+    GNSSSource source = USB;
+    GNSSFixQuality fixQuality = FIX_UNKNOWN;
+    SourceSelectionReason selectionReason = SELECTION_NONE;
     double latitude = NAN;
     double longitude = NAN;
     double altitude = NAN;
@@ -5,16 +5,14 @@ EventDispatcher::EventDispatcher() {
     Logger::instance().info("EventDispatcher", "Starting event dispatcher");
     threadPool = std::vector<std::thread>(4);
     for(size_t i = 0; i < threadPool.size(); i++){
-        Logger::instance().trace("EventDispatcher", "Creating event thread " + std::to_string(i));
+        LOG_TRACE("EventDispatcher", "Creating event thread " + std::to_string(i));
         threadPool[i] = std::thread(&EventDispatcher::asyncThreadHandler, this);
     }
 }
 
 EventDispatcher::~EventDispatcher() {
-    std::unique_lock<std::mutex> lock(threadLock);
     quitting = true;
-    notifier.notify_all();
-    threadLock.unlock();
+    jobsAvailable.release(static_cast<std::ptrdiff_t>(threadPool.size()));
     for(size_t i = 0; i < threadPool.size(); i++) {
         if(threadPool[i].joinable()) {
             threadPool[i].join();
@@ -22,46 +20,139 @@ EventDispatcher::~EventDispatcher() {
     }
 }
 
-void EventDispatcher::subscribe(const EventType eventType, EventListener *listener) {
+void EventDispatcher::addSubscription(const EventType eventType, EventListener *listener, const EventHandler handler) {
     //TODO: Add event type to logging
-    Logger::instance().debug("EventDispatcher", "Adding listener");
-    listeners[eventType].emplace_back(listener);
+    LOG_DEBUG("EventDispatcher", "Adding listener");
+    std::unique_lock lock(listenerLock);
+    Subscription sub{listener, handler, nullptr};
+    if(listener->serialized()) {
+        if(auto it = mailboxes.find(listener); it != mailboxes.end()) {
+            sub.mailbox = it->second.get();
+        } else if(mailboxes.size() < MAILBOX_SCHEDULE_SIZE) {
+            sub.mailbox = mailboxes.emplace(listener, std::make_unique<ListenerMailbox>()).first->second.get();
+        } else {
+            //A mailbox whose drain job could not be queued would never be emptied
+            Logger::instance().critical("EventDispatcher", "More than " + std::to_string(MAILBOX_SCHEDULE_SIZE) +
+                                        " serialized listeners, delivering without serialization");
+        }
+    }
+    listeners[eventType].push_back(sub);
 }
 
-void EventDispatcher::unsubscribe(const EventType eventType, EventListener *listener) {
-    //TODO: Add event type to logging
-    Logger::instance().debug("EventDispatcher", "Removing listener");
-    listeners[eventType].remove(listener);
+void EventDispatcher::unsubscribe(EventListener *listener) {
+    LOG_DEBUG("EventDispatcher", "Removing listener");
+    std::unique_lock lock(listenerLock);
+    for(auto& subs : listeners) {
+        std::erase_if(subs, [listener](const Subscription& sub) { return sub.listener == listener; });
+    }
+}
+
+void EventDispatcher::delivered(Event* ev) {
+    if(ev->pendingDeliveries_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        releaseEvent(ev);
+    }
 }
 
-void EventDispatcher::dispatchDirect(const std::shared_ptr<Event>& ev) {
+void EventDispatcher::dispatchDirect(Event* ev) {
     //TODO: Add event type to logging
-    Logger::instance().trace("EventDispatcher", "Dispatching direct event");
-    for(const auto listener : listeners[ev->eventType()]){
-        listener->notifyMessage(ev);
+    LOG_TRACE("EventDispatcher", "Dispatching direct event");
+    {
+        std::shared_lock lock(listenerLock);
+        for(const auto& sub : listeners[ev->eventType()]){
+            sub.handler(sub.listener, *ev);
+        }
     }
+    releaseEvent(ev);
 }
 
-void EventDispatcher::dispatchAsync(std::shared_ptr<Event> ev) {
-    std::unique_lock<std::mutex> lock(threadLock);
-    Logger::instance().trace("EventDispatcher", "Dispatching async event");
-    for(auto listener : this->listeners[ev->eventType()]) {
-    workerQueue.push([listener, ev] {
-        listener->notifyMessage(ev);
-    });}
-    notifier.notify_one();
+void EventDispatcher::dispatchAsync(Event* ev) {
+    LOG_TRACE("EventDispatcher", "Dispatching async event");
+    std::shared_lock lock(listenerLock);
+    const auto& subs = listeners[ev->eventType()];
+    if(subs.empty()) {
+        releaseEvent(ev);
+        return;
+    }
+    //Set the count before anything is queued, a fast worker may finish its delivery before this loop ends
+    ev->pendingDeliveries_.store(subs.size(), std::memory_order_relaxed);
+    std::ptrdiff_t queued = 0;
+    for(const auto& sub : subs) {
+        if(sub.mailbox != nullptr) {
+            if(!sub.mailbox->queue.push(MailboxEntry{sub.handler, ev})) {
+                //Never wait here, we hold listenerLock and may be running on the mailbox's own worker
+                if(sub.mailbox->dropped.fetch_add(1, std::memory_order_relaxed) % 1000 == 0) {
+                    Logger::instance().warn("EventDispatcher", "Listener mailbox full, " +
+                        std::to_string(sub.mailbox->dropped.load(std::memory_order_relaxed)) + " events dropped");
+                }
+                delivered(ev);
+                continue;
+            }
+            if(sub.mailbox->pending.fetch_add(1, std::memory_order_acq_rel) != 0) {
+                //A worker already owns this mailbox and will pick the event up
+                continue;
+            }
+            enqueue({sub.listener, nullptr, sub.mailbox, nullptr});
+        } else if(!enqueue({sub.listener, sub.handler, nullptr, ev})) {
+            //Same as a full mailbox, the workers that would empty the queue may be the ones dispatching into it
+            if(droppedJobs.fetch_add(1, std::memory_order_relaxed) % 1000 == 0) {
+                Logger::instance().warn("EventDispatcher", "Worker queue full, " +
+                    std::to_string(droppedJobs.load(std::memory_order_relaxed)) + " events dropped");
+            }
+            delivered(ev);
+            continue;
+        }
+        queued++;
+    }
+    //One release per queued job, so every job has a worker woken for it
+    if(queued > 0) {
+        jobsAvailable.release(queued);
+    }
+}
+
+bool EventDispatcher::enqueue(DispatchJob&& job) {
+    if(job.mailbox != nullptr) {
+        return mailboxQueue.push(job);
+    }
+    return workerQueue.push(job);
+}
+
+void EventDispatcher::drainMailbox(EventListener* listener, ListenerMailbox* mailbox) {
+    for(size_t count = 1;; count++) {
+        MailboxEntry entry;
+        //pending is only bumped after the push completes, so the entry is on its way even if not yet visible
+        while(!mailbox->queue.pop(entry)) {
+            std::this_thread::yield();
+        }
+        entry.handler(listener, *entry.ev);
+        delivered(entry.ev);
+        if(mailbox->pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            return;
+        }
+        if(count >= MAILBOX_DRAIN_LIMIT && enqueue({listener, nullptr, mailbox, nullptr})) {
+            //Still work left, hand the mailbox back to the pool rather than hogging this worker. Should that fail
+            //we keep draining here, waiting for room could block every worker.
+            jobsAvailable.release();
+            return;
+        }
+    }
 }
 
 void EventDispatcher::asyncThreadHandler() {
-    std::unique_lock<std::mutex> lock(threadLock);
-    while(!quitting) {
-        notifier.wait(lock, [this] { return (!workerQueue.empty() || quitting); });
-        if (!quitting && !workerQueue.empty()) {
-            auto job = std::move(workerQueue.front());
-            workerQueue.pop();
-            lock.unlock();
-            job();
-            lock.lock();
+    while(true) {
+        jobsAvailable.acquire();
+        if(quitting) {
+            return;
+        }
+        //Every release follows a push to one of the two queues, and any worker may take any job
+        DispatchJob job;
+        while(!mailboxQueue.pop(job) && !workerQueue.pop(job)) {
+            std::this_thread::yield();
+        }
+        if(job.mailbox != nullptr) {
+            drainMailbox(job.listener, job.mailbox);
+        } else {
+            job.handler(job.listener, *job.ev);
+            delivered(job.ev);
         }
     }
 }
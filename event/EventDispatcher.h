@@ -1,33 +1,115 @@
 #ifndef EVENTDISPATCHER_H
 #define EVENTDISPATCHER_H
-#include <functional>
+#include <array>
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <thread>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
-#include <list>
 #include <map>
+#include <mutex>
+#include <semaphore>
+#include <shared_mutex>
+#include <type_traits>
 
 #include "Event.h"
+#include "EventPool.h"
+#include "MpmcQueue.h"
+
+static constexpr size_t EVENT_TYPE_COUNT = POSITION + 1;
+static constexpr size_t DISPATCH_QUEUE_SIZE = 4096;
+static constexpr size_t MAILBOX_QUEUE_SIZE = 1024;
+//Each serialized listener has at most one drain job queued, so this also bounds the number of serialized listeners
+static constexpr size_t MAILBOX_SCHEDULE_SIZE = 256;
+//How many events a worker delivers to one serialized listener before giving other listeners a turn
+static constexpr size_t MAILBOX_DRAIN_LIMIT = 32;
 
 class EventListener{
 public:
-    virtual void notifyMessage(std::shared_ptr<Event> ev) = 0;
+    virtual ~EventListener() = default;
+    ///
+    /// Serialized listeners are never notified from two dispatcher threads at the same time, and receive async
+    /// events in the order they were dispatched.
+    ///
+    [[nodiscard]] virtual bool serialized() const { return false; }
+};
+
+template<typename>
+struct EventHandlerTraits;
+
+template<typename L, typename T>
+struct EventHandlerTraits<void (L::*)(const T&)> {
+    using Listener = L;
+    using EventT = T;
 };
 
 class EventDispatcher {
-    typedef std::function<void(void)> fp_t;
+    using EventHandler = void (*)(EventListener* listener, const Event& ev);
+
+    struct MailboxEntry {
+        EventHandler handler = nullptr;
+        Event* ev = nullptr;
+    };
+
+    ///
+    /// Events for a serialized listener are queued here. pending counts events queued but not yet delivered; whoever
+    /// moves it off zero schedules the mailbox on the shared queue, so only one worker drains it at a time. An event
+    /// that finds the mailbox full is dropped and counted in dropped: the dispatching thread may be the worker that
+    /// drains it, e.g. a listener dispatching from its own handler, and would wait forever.
+    ///
+    struct ListenerMailbox {
+        MpmcQueue<MailboxEntry, MAILBOX_QUEUE_SIZE> queue;
+        std::atomic<size_t> pending = 0;
+        std::atomic<unsigned long long> dropped = 0;
+    };
+
+    struct Subscription {
+        EventListener* listener = nullptr;
+        EventHandler handler = nullptr;
+        ListenerMailbox* mailbox = nullptr;
+    };
+
+    ///
+    /// A job either delivers ev to listener through handler, or (when mailbox is set) drains that listener's mailbox.
+    /// Drain jobs have a queue of their own that cannot fill up, so a mailbox with events in it is never left without
+    /// a worker; a delivery job that finds workerQueue full is dropped and counted in droppedJobs.
+    ///
+    struct DispatchJob {
+        EventListener* listener = nullptr;
+        EventHandler handler = nullptr;
+        ListenerMailbox* mailbox = nullptr;
+        Event* ev = nullptr;
+    };
 public:
     static EventDispatcher& instance(){
         static EventDispatcher i;
         return i;
     }
     ~EventDispatcher();
-    void dispatchDirect(const std::shared_ptr<Event>& ev);
-    void dispatchAsync(std::shared_ptr<Event> ev);
-    void subscribe(EventType eventType, EventListener* listener);
-    void unsubscribe(EventType eventType, EventListener* listener);
+
+    ///
+    /// Both dispatch calls take ownership of an event obtained from acquireEvent and return it to its pool once every
+    /// listener has been notified
+    ///
+    void dispatchDirect(Event* ev);
+    void dispatchAsync(Event* ev);
+
+    ///
+    /// Subscribes a listener member function to the event type it takes, e.g. subscribe<&Foo::handlePosition>(this)
+    /// for void Foo::handlePosition(const PositionEvent&). The cast back to the concrete event type is resolved at
+    /// compile time.
+    ///
+    template<auto Handler>
+    void subscribe(typename EventHandlerTraits<decltype(Handler)>::Listener* listener) {
+        using Traits = EventHandlerTraits<decltype(Handler)>;
+        using L = typename Traits::Listener;
+        using T = typename Traits::EventT;
+        static_assert(std::is_base_of_v<EventListener, L>, "Listeners must derive from EventListener");
+        static_assert(std::is_base_of_v<Event, T>, "Handlers must take an Event type");
+        addSubscription(T::TYPE, listener, [](EventListener* target, const Event& ev) {
+            (static_cast<L*>(target)->*Handler)(static_cast<const T&>(ev));
+        });
+    }
+    void unsubscribe(EventListener* listener);
 
     EventDispatcher(const EventDispatcher& other) = delete;
     EventDispatcher& operator= (const EventDispatcher &other) = delete;
@@ -35,14 +117,21 @@ public:
     EventDispatcher& operator= (const EventDispatcher&& other) = delete;
 
 private:
-    std::mutex threadLock;
+    std::shared_mutex listenerLock;
     std::vector<std::thread> threadPool;
-    std::queue<fp_t> workerQueue;
-    std::map<EventType, std::list<EventListener*>> listeners;
-    std::condition_variable notifier;
+    MpmcQueue<DispatchJob, DISPATCH_QUEUE_SIZE> workerQueue;
+    MpmcQueue<DispatchJob, MAILBOX_SCHEDULE_SIZE> mailboxQueue;
+    std::atomic<unsigned long long> droppedJobs = 0;
+    std::counting_semaphore<> jobsAvailable{0};
+    std::array<std::vector<Subscription>, EVENT_TYPE_COUNT> listeners;
+    std::map<EventListener*, std::unique_ptr<ListenerMailbox>> mailboxes;
 
-    bool quitting = false;
+    std::atomic<bool> quitting = false;
     void asyncThreadHandler();
+    void addSubscription(EventType eventType, EventListener* listener, EventHandler handler);
+    bool enqueue(DispatchJob&& job);
+    void drainMailbox(EventListener* listener, ListenerMailbox* mailbox);
+    static void delivered(Event* ev);
 
     EventDispatcher();
 };
@@ -0,0 +1,74 @@
+#ifndef EVENTPOOL_H
+#define EVENTPOOL_H
+
+#include "Event.h"
+#include "MpmcQueue.h"
+
+static constexpr size_t EVENT_POOL_SIZE = 256;
+
+///
+/// Per event type free list. acquire() hands out a recycled event when one is available and only allocates while the
+/// pool warms up; the dispatcher returns the event once every listener has seen it. Events are reset to their default
+/// state on the way back in, using the type's reset() when it has one so vectors keep their capacity.
+///
+template<typename T>
+class EventPool {
+public:
+    static EventPool& instance() {
+        static EventPool pool;
+        return pool;
+    }
+
+    T* acquire() {
+        T* ev = nullptr;
+        if (!free_.pop(ev)) {
+            ev = new T();
+        }
+        ev->recycle_ = &EventPool::recycle;
+        return ev;
+    }
+
+    EventPool(const EventPool&) = delete;
+    EventPool& operator=(const EventPool&) = delete;
+
+private:
+    EventPool() = default;
+    ~EventPool() {
+        T* ev = nullptr;
+        while (free_.pop(ev)) {
+            delete ev;
+        }
+    }
+
+    static void recycle(Event* ev) {
+        instance().release(static_cast<T*>(ev));
+    }
+
+    void release(T* ev) {
+        if constexpr (requires { ev->reset(); }) {
+            ev->reset();
+        } else {
+            *ev = T{};
+        }
+        if (!free_.push(ev)) {
+            delete ev;
+        }
+    }
+
+    MpmcQueue<T*, EVENT_POOL_SIZE> free_;
+};
+
+///
+/// Takes an event from its pool. Ownership passes to the dispatcher on dispatchAsync/dispatchDirect; an event that is
+/// acquired but never dispatched must be handed back with releaseEvent.
+///
+template<typename T>
+T* acquireEvent() {
+    return EventPool<T>::instance().acquire();
+}
+
+inline void releaseEvent(Event* ev) {
+    ev->recycle_(ev);
+}
+
+#endif //EVENTPOOL_H
@@ -0,0 +1,439 @@
+#include "PropertyCodec.h"
+
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+
+//Frames start with a varint of the value count shifted left by one, with the keyframe flag in the low bit
+static constexpr uint64_t CODEC_KEYFRAME = 0x01;
+
+//Value header, the low two bits are the kind
+static constexpr uint8_t CODEC_KIND_DELTA = 0;
+static constexpr uint8_t CODEC_KIND_DECIMAL = 1;
+static constexpr uint8_t CODEC_KIND_XOR = 2;
+static constexpr uint8_t CODEC_KIND_TEXT = 3;
+static constexpr uint8_t CODEC_SAME_INSTANCE = 0x04;
+static constexpr uint8_t CODEC_NEXT_PROPERTY = 0x08;
+//Text kind only, the value is the same text as last time
+static constexpr uint8_t CODEC_TEXT_REPEAT = 0x10;
+//Deltas below this are carried in the top nibble of the header
+static constexpr uint64_t CODEC_INLINE_DELTA = 15;
+//18 digits always fit an int64, and so does the difference of two of them
+static constexpr size_t CODEC_MAX_DIGITS = 18;
+
+static constexpr int64_t POWERS_OF_TEN[CODEC_MAX_DIGITS + 1] = {
+    1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000, 10000000000, 100000000000,
+    1000000000000, 10000000000000, 100000000000000, 1000000000000000, 10000000000000000, 100000000000000000,
+    1000000000000000000
+};
+
+static void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<char>(value));
+}
+
+static bool getVarint(std::string_view& in, uint64_t& value) {
+    value = 0;
+    for (unsigned int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+        const auto byte = static_cast<uint8_t>(in.front());
+        in.remove_prefix(1);
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static uint64_t zigzag(const int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t unzigzag(const uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+static void putString(std::string& out, const std::string_view value) {
+    putVarint(out, value.size());
+    out.append(value);
+}
+
+static bool getString(std::string_view& in, std::string_view& value) {
+    uint64_t length;
+    if (!getVarint(in, length) || length > in.size()) {
+        return false;
+    }
+    value = in.substr(0, length);
+    in.remove_prefix(length);
+    return true;
+}
+
+///
+/// Accepts plain decimals as std::to_string writes them, e.g. "42", "-3.140000". Anything that would not be written
+/// back byte for byte (leading zeros, "-0", exponents, too many digits) is left for the other kinds.
+///
+static bool parseDecimal(const std::string_view text, int64_t& mantissa, uint8_t& scale) {
+    size_t pos = text.starts_with('-') ? 1 : 0;
+    const bool negative = pos == 1;
+    const size_t intStart = pos;
+    int64_t value = 0;
+    size_t digits = 0;
+    while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+        value = value * 10 + (text[pos++] - '0');
+        digits++;
+    }
+    const size_t intDigits = pos - intStart;
+    if (intDigits == 0 || (intDigits > 1 && text[intStart] == '0')) {
+        return false;
+    }
+    scale = 0;
+    if (pos < text.size() && text[pos] == '.') {
+        pos++;
+        while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+            value = value * 10 + (text[pos++] - '0');
+            digits++;
+            scale++;
+        }
+        if (scale == 0) {
+            return false;
+        }
+    }
+    if (pos != text.size() || digits > CODEC_MAX_DIGITS || (negative && value == 0)) {
+        return false;
+    }
+    mantissa = negative ? -value : value;
+    return true;
+}
+
+static void formatDecimal(const int64_t mantissa, const uint8_t scale, std::string& out) {
+    out.clear();
+    char digits[24];
+    const uint64_t magnitude = mantissa < 0 ? 0 - static_cast<uint64_t>(mantissa) : static_cast<uint64_t>(mantissa);
+    const auto res = std::to_chars(digits, digits + sizeof(digits), magnitude);
+    std::string_view text(digits, res.ptr - digits);
+    if (mantissa < 0) {
+        out.push_back('-');
+    }
+    if (scale == 0) {
+        out.append(text);
+        return;
+    }
+    if (text.size() <= scale) {
+        out.append("0.");
+        out.append(scale - text.size(), '0');
+        out.append(text);
+        return;
+    }
+    out.append(text.substr(0, text.size() - scale));
+    out.push_back('.');
+    out.append(text.substr(text.size() - scale));
+}
+
+/// Trailing decimal zeros of a mantissa, zero counting as having all of its scale
+static uint8_t decimalZeros(int64_t mantissa, const uint8_t scale) {
+    if (mantissa == 0) {
+        return scale;
+    }
+    uint8_t zeros = 0;
+    while (zeros < scale && mantissa % 10 == 0) {
+        mantissa /= 10;
+        zeros++;
+    }
+    return zeros;
+}
+
+/// True when text is exactly how to_chars writes the double, so sending only its bits loses nothing
+static bool parseExactDouble(const std::string_view text, double& value) {
+    const auto res = std::from_chars(text.data(), text.data() + text.size(), value);
+    if (res.ec != std::errc{} || res.ptr != text.data() + text.size()) {
+        return false;
+    }
+    char buf[32];
+    const auto written = std::to_chars(buf, buf + sizeof(buf), value);
+    return std::string_view(buf, written.ptr - buf) == text;
+}
+
+void PropertyCodecState::reset() {
+    deviceIds_.clear();
+    propertyIds_.clear();
+    instanceIds_.clear();
+    devices_.clear();
+    properties_.clear();
+    instances_.clear();
+    slots_.clear();
+}
+
+PropertySlot& PropertyCodecState::slot(const uint32_t device, const uint32_t property, const uint32_t instance) {
+    const uint64_t key = static_cast<uint64_t>(device) << 44 | static_cast<uint64_t>(property & 0xFFFFFF) << 20 |
+                         (instance & 0xFFFFF);
+    return slots_[key];
+}
+
+uint32_t PropertyCodecState::intern(std::unordered_map<std::string, uint32_t>& ids, std::vector<std::string>& names,
+                                    const std::string_view name, bool& added) {
+    const auto [it, inserted] = ids.try_emplace(std::string(name), static_cast<uint32_t>(names.size()));
+    added = inserted;
+    if (inserted) {
+        names.emplace_back(name);
+    }
+    return it->second;
+}
+
+void PropertyEncoder::reset() {
+    PropertyCodecState::reset();
+    keyframe_ = true;
+}
+
+void PropertyEncoder::encode(const NMEAPropertyEvent& ev, std::string& out) {
+    out.clear();
+    putVarint(out, ev.values().size() << 1 | (keyframe_ ? CODEC_KEYFRAME : 0));
+    keyframe_ = false;
+
+    bool added;
+    const uint32_t device = intern(deviceIds_, devices_, ev.deviceUid, added);
+    if (added) {
+        putVarint(out, 0);
+        putString(out, ev.deviceUid);
+    } else {
+        putVarint(out, device + 1);
+    }
+
+    uint32_t lastProperty = UINT32_MAX;
+    uint32_t lastInstance = UINT32_MAX;
+    for (const auto& record : ev.values()) {
+        const size_t headerPos = out.size();
+        uint8_t header = 0;
+        out.push_back(0);
+
+        const uint32_t property = intern(propertyIds_, properties_, record.propertyUid, added);
+        if (!added && lastProperty != UINT32_MAX && property == lastProperty + 1) {
+            header |= CODEC_NEXT_PROPERTY;
+        } else if (added) {
+            putVarint(out, 0);
+            putString(out, record.propertyUid);
+        } else {
+            putVarint(out, property + 1);
+        }
+        lastProperty = property;
+
+        const uint32_t instance = intern(instanceIds_, instances_, record.instance, added);
+        if (!added && instance == lastInstance) {
+            header |= CODEC_SAME_INSTANCE;
+        } else if (added) {
+            putVarint(out, 0);
+            putString(out, record.instance);
+        } else {
+            putVarint(out, instance + 1);
+        }
+        lastInstance = instance;
+
+        PropertySlot& last = slot(device, property, instance);
+        int64_t mantissa;
+        uint8_t scale;
+        double number;
+        if (parseDecimal(record.value, mantissa, scale)) {
+            const int64_t difference = mantissa - last.mantissa;
+            if (last.hasDecimal && last.scale == scale && difference % POWERS_OF_TEN[last.quantum] == 0) {
+                header |= CODEC_KIND_DELTA;
+                const uint64_t delta = zigzag(difference / POWERS_OF_TEN[last.quantum]);
+                if (delta < CODEC_INLINE_DELTA) {
+                    header |= static_cast<uint8_t>(delta << 4);
+                } else {
+                    header |= static_cast<uint8_t>(CODEC_INLINE_DELTA << 4);
+                    putVarint(out, delta - CODEC_INLINE_DELTA);
+                }
+            } else {
+                header |= CODEC_KIND_DECIMAL;
+                out.push_back(static_cast<char>(scale));
+                putVarint(out, zigzag(mantissa));
+                last.quantum = last.hasDecimal && last.scale == scale ? std::min(last.quantum, decimalZeros(mantissa, scale))
+                                                                      : decimalZeros(mantissa, scale);
+            }
+            last.mantissa = mantissa;
+            last.scale = scale;
+            last.hasDecimal = true;
+        } else if (parseExactDouble(record.value, number)) {
+            header |= CODEC_KIND_XOR;
+            const uint64_t bits = std::bit_cast<uint64_t>(number);
+            const uint64_t diff = bits ^ last.bits;
+            //Close values share sign, exponent and the top of the mantissa, so the XOR is mostly zeros at the top
+            //and, for round numbers, at the bottom
+            const int trailing = std::countr_zero(diff);
+            out.push_back(static_cast<char>(trailing));
+            if (trailing < 64) {
+                putVarint(out, diff >> trailing);
+            }
+            last.bits = bits;
+        } else {
+            header |= CODEC_KIND_TEXT;
+            if (record.value == last.text) {
+                header |= CODEC_TEXT_REPEAT;
+            } else {
+                putString(out, record.value);
+                last.text = record.value;
+            }
+        }
+        out[headerPos] = static_cast<char>(header);
+    }
+}
+
+bool PropertyDecoder::decode(std::string_view in, NMEAPropertyEvent& ev) {
+    ev.reset();
+    uint64_t count;
+    if (!getVarint(in, count)) {
+        return false;
+    }
+    if (count & CODEC_KEYFRAME) {
+        PropertyCodecState::reset();
+        synced_ = true;
+    }
+    count >>= 1;
+    if (!synced_) {
+        return false;
+    }
+
+    //A frame that fails part way has already changed the state, so nothing decodes until the next keyframe
+    synced_ = false;
+    bool added;
+    uint64_t ref;
+    std::string_view name;
+    if (!getVarint(in, ref)) {
+        return false;
+    }
+    uint32_t device;
+    if (ref == 0) {
+        if (!getString(in, name)) {
+            return false;
+        }
+        device = intern(deviceIds_, devices_, name, added);
+    } else if (ref <= devices_.size()) {
+        device = static_cast<uint32_t>(ref - 1);
+    } else {
+        return false;
+    }
+    ev.deviceUid = devices_[device];
+    uint32_t property = UINT32_MAX;
+    uint32_t instance = UINT32_MAX;
+    for (uint64_t i = 0; i < count; i++) {
+        if (in.empty()) {
+            return false;
+        }
+        const auto header = static_cast<uint8_t>(in.front());
+        in.remove_prefix(1);
+
+        if (header & CODEC_NEXT_PROPERTY) {
+            if (property == UINT32_MAX || property + 1 >= properties_.size()) {
+                return false;
+            }
+            property++;
+        } else {
+            if (!getVarint(in, ref)) {
+                return false;
+            }
+            if (ref == 0) {
+                if (!getString(in, name)) {
+                    return false;
+                }
+                property = intern(propertyIds_, properties_, name, added);
+            } else if (ref <= properties_.size()) {
+                property = static_cast<uint32_t>(ref - 1);
+            } else {
+                return false;
+            }
+        }
+
+        if (header & CODEC_SAME_INSTANCE) {
+            if (instance == UINT32_MAX) {
+                return false;
+            }
+        } else {
+            if (!getVarint(in, ref)) {
+                return false;
+            }
+            if (ref == 0) {
+                if (!getString(in, name)) {
+                    return false;
+                }
+                instance = intern(instanceIds_, instances_, name, added);
+            } else if (ref <= instances_.size()) {
+                instance = static_cast<uint32_t>(ref - 1);
+            } else {
+                return false;
+            }
+        }
+
+        PropertySlot& last = slot(device, property, instance);
+        switch (header & 0x03) {
+            case CODEC_KIND_DELTA: {
+                if (!last.hasDecimal) {
+                    return false;
+                }
+                uint64_t delta = header >> 4;
+                if (delta == CODEC_INLINE_DELTA) {
+                    if (!getVarint(in, delta)) {
+                        return false;
+                    }
+                    delta += CODEC_INLINE_DELTA;
+                }
+                last.mantissa += unzigzag(delta) * POWERS_OF_TEN[last.quantum];
+                formatDecimal(last.mantissa, last.scale, text_);
+                break;
+            }
+            case CODEC_KIND_DECIMAL: {
+                uint64_t mantissa;
+                if (in.empty()) {
+                    return false;
+                }
+                const auto scale = static_cast<uint8_t>(in.front());
+                in.remove_prefix(1);
+                if (scale > CODEC_MAX_DIGITS || !getVarint(in, mantissa)) {
+                    return false;
+                }
+                last.quantum = last.hasDecimal && last.scale == scale
+                                   ? std::min(last.quantum, decimalZeros(unzigzag(mantissa), scale))
+                                   : decimalZeros(unzigzag(mantissa), scale);
+                last.scale = scale;
+                last.mantissa = unzigzag(mantissa);
+                last.hasDecimal = true;
+                formatDecimal(last.mantissa, last.scale, text_);
+                break;
+            }
+            case CODEC_KIND_XOR: {
+                if (in.empty()) {
+                    return false;
+                }
+                const auto trailing = static_cast<uint8_t>(in.front());
+                in.remove_prefix(1);
+                uint64_t diff = 0;
+                if (trailing < 64) {
+                    if (!getVarint(in, diff)) {
+                        return false;
+                    }
+                    diff <<= trailing;
+                }
+                last.bits ^= diff;
+                char buf[32];
+                const auto res = std::to_chars(buf, buf + sizeof(buf), std::bit_cast<double>(last.bits));
+                text_.assign(buf, res.ptr);
+                break;
+            }
+            default: {
+                if (!(header & CODEC_TEXT_REPEAT)) {
+                    if (!getString(in, name)) {
+                        return false;
+                    }
+                    last.text.assign(name);
+                }
+                text_ = last.text;
+                break;
+            }
+        }
+        ev.addValue(properties_[property], instances_[instance], text_);
+    }
+    synced_ = in.empty();
+    return synced_;
+}
@@ -0,0 +1,77 @@
+#ifndef PROPERTYCODEC_H
+#define PROPERTYCODEC_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "Event.h"
+
+///
+/// Last value sent for one device, property and instance. Both ends keep the same slots, so a value only needs to
+/// carry how it differs from the previous one.
+///
+struct PropertySlot {
+    int64_t mantissa = 0; //Decimal text as an integer, scaled by 10^scale
+    uint8_t scale = 0;
+    uint8_t quantum = 0; //Deltas are sent in units of 10^quantum, the fewest trailing zeros seen at this scale
+    bool hasDecimal = false;
+    uint64_t bits = 0; //Last value sent as a raw double
+    std::string text; //Last value sent as text
+};
+
+///
+/// State shared by the encoder and decoder. Device uids, property uids and instances are given integer ids in the
+/// order they are first seen; the first frame to use one carries the string, later frames only the id.
+///
+class PropertyCodecState {
+public:
+    void reset();
+
+protected:
+    std::unordered_map<std::string, uint32_t> deviceIds_;
+    std::unordered_map<std::string, uint32_t> propertyIds_;
+    std::unordered_map<std::string, uint32_t> instanceIds_;
+    std::vector<std::string> devices_;
+    std::vector<std::string> properties_;
+    std::vector<std::string> instances_;
+    std::unordered_map<uint64_t, PropertySlot> slots_;
+
+    PropertySlot& slot(uint32_t device, uint32_t property, uint32_t instance);
+    static uint32_t intern(std::unordered_map<std::string, uint32_t>& ids, std::vector<std::string>& names,
+                           std::string_view name, bool& added);
+};
+
+///
+/// Encodes NMEAPropertyEvents into a compact binary frame for the uplink. Each value costs a header byte holding the
+/// value kind, whether it continues the previous property id and instance, and for small changes the delta itself:
+///   - decimal text such as "12.500000" becomes a scaled integer sent as a zigzag varint delta from the last value,
+///     in units of the slot's quantum so std::to_string's padding zeros cost nothing
+///   - other numbers are sent as the XOR of their double bits with the last value
+///   - anything else is sent as text, or as a single flag when it is the same text as last time
+/// Frames must be decoded in the order they were encoded. After reset() the next frame is a keyframe that clears the
+/// decoder's state, so a sink that loses frames can resynchronise.
+///
+class PropertyEncoder : public PropertyCodecState {
+public:
+    /// Replaces out with the encoded frame
+    void encode(const NMEAPropertyEvent& ev, std::string& out);
+    void reset();
+
+private:
+    bool keyframe_ = true;
+};
+
+class PropertyDecoder : public PropertyCodecState {
+public:
+    /// Decodes one frame into ev, returns false if it is truncated, refers to unknown ids or needs a keyframe first
+    bool decode(std::string_view in, NMEAPropertyEvent& ev);
+
+private:
+    bool synced_ = false;
+    std::string text_;
+};
+
+#endif //PROPERTYCODEC_H
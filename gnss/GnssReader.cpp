@@ -1,105 +1,246 @@
 #include "GnssReader.h"
 #include "../utils/StringUtils.h"
 
-#include <boost/asio/read_until.hpp>
+#include <chrono>
+#include <cstring>
+#include <boost/asio/post.hpp>
+#include <boost/asio/write.hpp>
 
+#include "../config/ConfigProvider.h"
 #include "../event/EventDispatcher.h"
 #include "../logging/Logger.h"
-#include "../utils/NMEAUtils.h"
+#include "../utils/TimeUtils.h"
 
 GnssReader::GnssReader(boost::asio::io_context& ioCtx, const std::string& port): serialPort_(ioCtx) {
     Logger::instance().info("GnssReader", "Initializing GnssReader on port " + port);
+    maxCorrectionAgeMs_ = std::max(ConfigProvider::instance().rtcmMaxAge(), 0);
     boost::system::error_code ec;
     serialPort_.open(port, ec);
     if(ec) {
         Logger::instance().error("GnssReader", "Error opening GNSS serial port: " + ec.message());
         return;
     }
+    if (ConfigProvider::instance().gnssProtocol() == "UBX") {
+        configureUbx(ConfigProvider::instance().gnssRate());
+    }
+    EventDispatcher::instance().subscribe<&GnssReader::handleRtkCorrectionEvent>(this);
     readOperation();
 }
 
+GnssReader::~GnssReader() {
+    EventDispatcher::instance().unsubscribe(this);
+}
+
+void GnssReader::configureUbx(const int rateHz) {
+    //Version 0, apply to the RAM layer only so a power cycle returns the receiver to its saved configuration
+    std::vector<uint8_t> payload = {0x00, 0x01, 0x00, 0x00};
+    //NAV-PVT every epoch, satellites and time roughly once a second
+    const uint32_t slowRate = rateHz > 1 ? std::min(rateHz, 255) : 1;
+    appendUbxConfigValue(payload, UBX_CFG_MSGOUT_NAV_PVT_USB, 1);
+    appendUbxConfigValue(payload, UBX_CFG_MSGOUT_NAV_PVT_UART1, 1);
+    appendUbxConfigValue(payload, UBX_CFG_MSGOUT_NAV_SAT_USB, slowRate);
+    appendUbxConfigValue(payload, UBX_CFG_MSGOUT_NAV_SAT_UART1, slowRate);
+    appendUbxConfigValue(payload, UBX_CFG_MSGOUT_NAV_TIMEUTC_USB, slowRate);
+    appendUbxConfigValue(payload, UBX_CFG_MSGOUT_NAV_TIMEUTC_UART1, slowRate);
+    appendUbxConfigValue(payload, UBX_CFG_USBOUTPROT_UBX, 1);
+    appendUbxConfigValue(payload, UBX_CFG_UART1OUTPROT_UBX, 1);
+    appendUbxConfigValue(payload, UBX_CFG_USBOUTPROT_NMEA, 0);
+    appendUbxConfigValue(payload, UBX_CFG_UART1OUTPROT_NMEA, 0);
+    if (rateHz > 0) {
+        appendUbxConfigValue(payload, UBX_CFG_RATE_MEAS, 1000 / rateHz);
+    }
+    Logger::instance().info("GnssReader", "Configuring receiver for UBX output at " + std::to_string(rateHz) + "Hz");
+    queueWrite({buildUbxFrame(UBX_CLASS_CFG, UBX_CFG_VALSET, payload), 0, 0}, RTCM_PRIORITY_HIGH);
+}
+
+void GnssReader::handleRtkCorrectionEvent(const RTKCorrectionEvent& ev) {
+    //Called on a dispatcher thread, the queue belongs to the io context
+    boost::asio::post(serialPort_.get_executor(), [this, write = PendingWrite{ev.frame, ev.messageType, ev.received}]() mutable {
+        const RtcmPriority priority = rtcmPriority(write.messageType);
+        queueWrite(std::move(write), priority);
+    });
+}
+
+void GnssReader::queueWrite(PendingWrite write, const RtcmPriority priority) {
+    auto& queue = writeQueue_[priority];
+    if (write.messageType != 0) {
+        for (auto& queued : queue) {
+            if (queued.messageType == write.messageType) {
+                //A newer epoch of the same message makes the queued one useless
+                queued = std::move(write);
+                correctionsDropped_++;
+                return;
+            }
+        }
+    }
+    queue.push_back(std::move(write));
+    writeNext();
+}
+
+void GnssReader::writeNext() {
+    if (writeInFlight_) {
+        return;
+    }
+    const unsigned long long now = systemTimeMillis();
+    for (auto& queue : writeQueue_) {
+        while (!queue.empty()) {
+            writing_ = std::move(queue.front());
+            queue.pop_front();
+            if (writing_.messageType != 0 && now - writing_.received > maxCorrectionAgeMs_) {
+                if (correctionsDropped_++ % 100 == 0) {
+                    Logger::instance().warn("GnssReader", "Dropping stale RTCM " + std::to_string(writing_.messageType) +
+                                            ", " + std::to_string(correctionsDropped_) + " corrections dropped so far");
+                }
+                continue;
+            }
+            writeInFlight_ = true;
+            boost::asio::async_write(serialPort_, boost::asio::buffer(writing_.data),
+                [this](const boost::system::error_code& ec, std::size_t) {
+                writeInFlight_ = false;
+                if (ec) {
+                    Logger::instance().error("GnssReader", writing_.messageType == 0
+                        ? "Error writing receiver configuration: " + ec.message()
+                        : "Error writing RTCM " + std::to_string(writing_.messageType) + ": " + ec.message());
+                } else if (writing_.messageType != 0 && correctionsWritten_++ == 0) {
+                    Logger::instance().info("GnssReader", "Streaming RTK corrections to the receiver");
+                }
+                writeNext();
+            });
+            return;
+        }
+    }
+}
+
 void GnssReader::readOperation() {
-    boost::asio::async_read_until(serialPort_, buffer_, "\r\n", [this](const boost::system::error_code& ec,
-        const std::size_t length) {
+    serialPort_.async_read_some(boost::asio::buffer(dataBuf_.data() + pending_, dataBuf_.size() - pending_),
+        [this](const boost::system::error_code& ec, const std::size_t length) {
         readHandler(ec, length);
     });
 }
 
 void GnssReader::readHandler(const boost::system::error_code &ec, const std::size_t length) {
-    Logger::instance().trace("GnssReader", "Read " + std::to_string(length) + " bytes");
+    LOG_TRACE("GnssReader", "Read " + std::to_string(length) + " bytes");
     if(!ec) {
-        std::string line;
-        std::istream is(&buffer_);
-        std::getline(is, line);
-        if (!line.empty() && line.back() == '\r')
-            line.pop_back();
-        handlePacket(line);
+        pending_ += length;
+        processPending();
     } else {
         Logger::instance().error("GnssReader", "Error receiving data from serial port: " + ec.message());
     }
     readOperation();
 }
 
-void GnssReader::handlePacket(const std::string& line) {
-    const size_t splitPos = line.find_first_of(',');
-    const size_t starPos = line.find_last_of('*');
-    if(splitPos == std::string::npos || splitPos == 0) {
-        Logger::instance().warn("GnssReader", "Invalid line format, cannot parse token");
-        Logger::instance().debug("GnssReader", "LINE: " + line);
-        return;
+void GnssReader::feed(std::string_view data) {
+    while (!data.empty()) {
+        const size_t count = std::min(data.size(), dataBuf_.size() - pending_);
+        std::memcpy(dataBuf_.data() + pending_, data.data(), count);
+        pending_ += count;
+        data.remove_prefix(count);
+        processPending();
     }
-    const std::string token = line.substr(0, splitPos);
-    if(token.at(0) != '$'){
-        Logger::instance().warn("GnssReader", "Invalid token start char: " + token );
-        Logger::instance().debug("GnssReader", "LINE: " + line);
-        return;
+}
+
+void GnssReader::processPending() {
+    //Hand every complete UBX frame and NMEA line to its parser in place, then keep any partial message for the
+    //next read. Anything that is neither is skipped a byte at a time until we find a sync char or '$' again.
+    size_t pos = 0;
+    while (pos < pending_) {
+        const std::string_view data(dataBuf_.data() + pos, pending_ - pos);
+        if (static_cast<uint8_t>(data[0]) == UBX_SYNC_1) {
+            UbxFrame frame;
+            size_t consumed = 0;
+            const UbxParseResult res = parseUbxFrame(data, frame, consumed);
+            if (res == UbxParseResult::INCOMPLETE) {
+                break;
+            }
+            if (res == UbxParseResult::OK) {
+                handleUbxFrame(frame);
+                pos += consumed;
+                continue;
+            }
+            if (res == UbxParseResult::INVALID_CHECKSUM) {
+                Logger::instance().warn("GnssReader", "Invalid checksum in UBX frame");
+            }
+            pos++;
+            continue;
+        }
+        if (data[0] != '$') {
+            pos++;
+            continue;
+        }
+        const size_t lineEnd = data.find('\n');
+        if (lineEnd == std::string_view::npos) {
+            break;
+        }
+        std::string_view line = data.substr(0, lineEnd);
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        handlePacket(line);
+        pos += lineEnd + 1;
     }
-    if(line.at(line.size()-3) != '*') {
-        Logger::instance().warn("GnssReader", "No checksum in " + token + " message");
-        Logger::instance().debug("GnssReader", "LINE: " + line);
-        return;
+    if (pos > 0) {
+        std::memmove(dataBuf_.data(), dataBuf_.data() + pos, pending_ - pos);
+        pending_ -= pos;
+    } else if (pending_ == dataBuf_.size()) {
+        Logger::instance().warn("GnssReader", "No line ending in receive buffer, discarding");
+        pending_ = 0;
     }
-    if (!validateChecksum(line)) {
-        Logger::instance().warn("GnssReader", "Invalid checksum in " + token + " message");
-        Logger::instance().debug("GnssReader", "LINE: " + line);
-        return;
+}
+
+void GnssReader::handlePacket(const std::string_view line) {
+    NmeaSentence sentence;
+    switch (parseNmeaSentence(line, sentence)) {
+        case NmeaParseResult::OK:
+            break;
+        case NmeaParseResult::INVALID_START:
+            Logger::instance().warn("GnssReader", "Invalid line format, cannot parse token");
+            LOG_DEBUG("GnssReader", "LINE: " + std::string(line));
+            return;
+        case NmeaParseResult::NO_CHECKSUM:
+            Logger::instance().warn("GnssReader", "No checksum in " + std::string(sentence.address) + " message");
+            LOG_DEBUG("GnssReader", "LINE: " + std::string(line));
+            return;
+        case NmeaParseResult::INVALID_CHECKSUM:
+            Logger::instance().warn("GnssReader", "Invalid checksum in " + std::string(sentence.address) + " message");
+            LOG_DEBUG("GnssReader", "LINE: " + std::string(line));
+            return;
+        case NmeaParseResult::TOO_MANY_FIELDS:
+            Logger::instance().warn("GnssReader", "Too many fields in " + std::string(sentence.address) + " message");
+            LOG_DEBUG("GnssReader", "LINE: " + std::string(line));
+            return;
     }
     //TODO: add missing handlers
-    std::string sentenceId;
-    const std::string sentence = line.substr(splitPos+1, starPos-7);
-    if (token == "$PUBX") {
+    if (sentence.sentenceId == "PUBX") {
         handleUbx(sentence);
         return;
     }
-    const std::string talker = token.substr(1, 2);
-    sentenceId = token.substr(3, 3);
-    Logger::instance().trace("GnssReader", line);
-    switch(stringHash(sentenceId.c_str())) {
+    LOG_TRACE("GnssReader", std::string(line));
+    switch(stringHash(sentence.sentenceId)) {
         case stringHash("RMC"): {
             //Probably noop this
-            handleRmc(talker, sentence);
+            handleRmc(sentence);
             break;
         }
         case stringHash("GGA"): {
-            handleGga(talker, sentence);
+            handleGga(sentence);
             break;
         }
         case stringHash("GSA"): {
-            handleGsa(talker, sentence);
+            handleGsa(sentence);
             break;
         }
         case stringHash("GSV"): {
             //Probably noop this
-            handleGsv(talker, sentence);
+            handleGsv(sentence);
             break;
         }
         case stringHash("GLL"): {
             //Probably noop this
-            handleGll(talker, sentence);
+            handleGll(sentence);
             break;
         }
         case stringHash("VTG"): {
-            handleVtg(talker, sentence);
+            handleVtg(sentence);
             break;
         }
         case stringHash("TXT"): {
@@ -107,49 +248,26 @@ void GnssReader::handlePacket(const std::string& line) {
             break;
         }
         default:
-        Logger::instance().debug("GnssReader", "Unknown token: " + token);
+        LOG_DEBUG("GnssReader", "Unknown token: " + std::string(sentence.address));
     }
 }
 
-bool GnssReader::validateChecksum(const std::string &line) {
-    if (line.empty() || line[0] != '$')
-        return false;
-
-    const auto star = line.find_last_of('*');
-    if (star == std::string::npos || star + 2 >= line.size())
-        return false;
-
-    unsigned char checksum = 0;
-    for (size_t i = 1; i < star; ++i)
-        checksum ^= static_cast<unsigned char>(line[i]);
-
-    const auto hex = line.substr(star + 1, 2);
-    if (!std::isxdigit(hex[0]) || !std::isxdigit(hex[1]))
-        return false;
-
-    const unsigned int expected = std::stoul(hex, nullptr, 16);
-
-    return checksum == expected;
-}
-
-
-void GnssReader::handleUbx(const std::string& sentence) {
-    switch(const auto split = splitString(sentence, ','); stringHash(split[0].c_str())){
+void GnssReader::handleUbx(const NmeaSentence& sentence) {
+    switch(stringHash(sentence.field(0))){
         case stringHash("00"): {
             //Position
-            const double lat = nmeaPositionToDecimal(split[2], split[3]);
-            const double lon = nmeaPositionToDecimal(split[4], split[5]);
-            const double alt = strtod(split[6].c_str(), nullptr);
-            const std::string navStat = split[7];
-            const double hAcc = strtod(split[8].c_str(), nullptr);
-            const double vAcc = strtod(split[9].c_str(), nullptr);
-            const double spd = strtod(split[10].c_str(), nullptr);
-            const double hdg = strtod(split[11].c_str(), nullptr);
-            const double vVel = -strtod(split[12].c_str(), nullptr);
-            const double ageC = strtod(split[13].c_str(), nullptr);
-            const double hdop = strtod(split[14].c_str(), nullptr);
-
-            const auto ev = std::make_shared<GNSSPositionEvent>();
+            const double lat = nmeaPositionToDecimal(sentence.field(2), sentence.field(3));
+            const double lon = nmeaPositionToDecimal(sentence.field(4), sentence.field(5));
+            const double alt = sentence.number(6);
+            const double hAcc = sentence.number(8);
+            const double vAcc = sentence.number(9);
+            const double spd = sentence.number(10) / 3.6; //km/h
+            const double hdg = sentence.number(11);
+            const double vVel = -sentence.number(12);
+            const double ageC = sentence.number(13);
+            const double hdop = sentence.number(14);
+
+            auto* ev = acquireEvent<GNSSPositionEvent>();
             ev->latitude = lat;
             ev->longitude = lon;
             ev->altitude = alt;
@@ -160,6 +278,8 @@ void GnssReader::handleUbx(const std::string& sentence) {
             ev->heading = hdg;
             ev->vVelocity = vVel;
             ev->correctionAge = ageC;
+            ev->timeOfFix = nmeaTimeToSeconds(sentence.field(1));
+            ev->fixQuality = fixQualityFromNavStat(sentence.field(7));
             ev->constellation = COMBINED;
             EventDispatcher::instance().dispatchAsync(ev);
             break;
@@ -173,143 +293,249 @@ void GnssReader::handleUbx(const std::string& sentence) {
             break;
         }
     default:
-        Logger::instance().debug("GnssReader", "Unknown UBX token: " + split[0]);
+        LOG_DEBUG("GnssReader", "Unknown UBX token: " + std::string(sentence.field(0)));
     }
 }
 
-void GnssReader::handleRmc(const std::string& talker, const std::string& sentence) {
-    const auto split = splitString(sentence, ',');
+void GnssReader::handleUbxFrame(const UbxFrame& frame) {
+    if (frame.msgClass == UBX_CLASS_NAV) {
+        switch (frame.msgId) {
+            case UBX_NAV_PVT:
+                handleNavPvt(frame);
+                return;
+            case UBX_NAV_SAT:
+                handleNavSat(frame);
+                return;
+            case UBX_NAV_TIMEUTC:
+                handleNavTimeUtc(frame);
+                return;
+            default:
+                break;
+        }
+    } else if (frame.msgClass == UBX_CLASS_ACK && frame.length >= 2 && frame.u1(0) == UBX_CLASS_CFG) {
+        if (frame.msgId == UBX_ACK_NAK) {
+            Logger::instance().warn("GnssReader", "Receiver rejected configuration message " + std::to_string(frame.u1(1)));
+        } else {
+            Logger::instance().info("GnssReader", "Receiver accepted configuration");
+        }
+        return;
+    }
+    LOG_DEBUG("GnssReader", "Unhandled UBX message " + std::to_string(frame.msgClass) + "/" + std::to_string(frame.msgId));
+}
+
+void GnssReader::handleNavPvt(const UbxFrame& frame) {
+    if (frame.length < 92) {
+        Logger::instance().warn("GnssReader", "Short NAV-PVT message: " + std::to_string(frame.length) + " bytes");
+        return;
+    }
+    //Upper bound in seconds of each flags3 lastCorrectionAge bucket
+    static constexpr double CORRECTION_AGES[] = {NAN, 1, 2, 5, 10, 15, 20, 30, 45, 60, 90, 120, 120};
+    const uint8_t fixType = frame.u1(20);
+    const bool fixOk = frame.u1(21) & 0x01;
+    //2D, 3D and GNSS+DR fixes carry a usable position
+    if (!fixOk || fixType < 2 || fixType > 4) {
+        Logger::instance().warn("GnssReader", "Position not valid: NAV-PVT fix type " + std::to_string(fixType));
+        return;
+    }
+    const uint8_t correctionAge = (frame.u2(78) >> 1) & 0x0F;
+    const uint8_t carrierSolution = (frame.u1(21) >> 6) & 0x03;
+
+    auto* ev = acquireEvent<GNSSPositionEvent>();
+    ev->longitude = frame.i4(24) * 1e-7;
+    ev->latitude = frame.i4(28) * 1e-7;
+    ev->altitude = frame.i4(36) / 1000.0;
+    ev->hAccuracy = frame.u4(40) / 1000.0;
+    ev->vAccuracy = frame.u4(44) / 1000.0;
+    ev->vVelocity = -frame.i4(56) / 1000.0;
+    ev->speed = frame.i4(60) / 1000.0;
+    ev->heading = frame.i4(64) * 1e-5;
+    ev->correctionAge = correctionAge < std::size(CORRECTION_AGES) ? CORRECTION_AGES[correctionAge] : NAN;
+    if (frame.u1(11) & 0x02) {
+        ev->timeOfFix = frame.u1(8) * 3600 + frame.u1(9) * 60 + frame.u1(10) + frame.i4(16) * 1e-9;
+    }
+    ev->epochComplete = true;
+    ev->fixQuality = carrierSolution == 2 ? FIX_RTK_FIXED : carrierSolution == 1 ? FIX_RTK_FLOAT :
+                     frame.u1(21) & 0x02 ? FIX_DGNSS : FIX_GNSS;
+    ev->constellation = COMBINED;
+    EventDispatcher::instance().dispatchAsync(ev);
+}
+
+void GnssReader::handleNavSat(const UbxFrame& frame) {
+    if (frame.length < 8) {
+        return;
+    }
+    const uint8_t numSvs = frame.u1(5);
+    if (frame.length < 8 + numSvs * 12) {
+        Logger::instance().warn("GnssReader", "Short NAV-SAT message: " + std::to_string(frame.length) + " bytes");
+        return;
+    }
+    for (auto& [constellation, buffer] : svBuffer_) {
+        buffer.clear();
+    }
+    for (size_t i = 0; i < numSvs; i++) {
+        const size_t offset = 8 + i * 12;
+        GNSSSatelliteRecord record;
+        record.satelliteId = frame.u1(offset + 1);
+        record.snr = frame.u1(offset + 2);
+        record.elevation = frame.i1(offset + 3);
+        record.azimuth = frame.i2(offset + 4);
+        svBuffer_[constellationFromGnssId(frame.u1(offset))].push_back(record);
+    }
+    for (const auto& [constellation, buffer] : svBuffer_) {
+        if (buffer.empty()) {
+            continue;
+        }
+        auto* ev = acquireEvent<GNSSSatellitesEvent>();
+        ev->constellation = constellation;
+        ev->satsInView = buffer.size();
+        ev->satellites = buffer;
+        EventDispatcher::instance().dispatchAsync(ev);
+    }
+}
+
+void GnssReader::handleNavTimeUtc(const UbxFrame& frame) {
+    if (frame.length < 20) {
+        Logger::instance().warn("GnssReader", "Short NAV-TIMEUTC message: " + std::to_string(frame.length) + " bytes");
+        return;
+    }
+    if (!(frame.u1(19) & 0x04)) {
+        LOG_DEBUG("GnssReader", "UTC time not yet valid");
+        return;
+    }
+    using namespace std::chrono;
+    const sys_days date{year{frame.u2(12)} / month{frame.u1(14)} / day{frame.u1(15)}};
+    const auto time = date + hours{frame.u1(16)} + minutes{frame.u1(17)} + seconds{frame.u1(18)} +
+                      duration_cast<milliseconds>(nanoseconds{frame.i4(8)});
+
+    auto* ev = acquireEvent<GNSSTodEvent>();
+    ev->timestamp = duration_cast<milliseconds>(time.time_since_epoch()).count();
+    ev->accuracy = frame.u4(4) * 1e-9;
+    EventDispatcher::instance().dispatchAsync(ev);
+}
 
-    const double lat = nmeaPositionToDecimal(split[2], split[3]);
-    const double lon = nmeaPositionToDecimal(split[4], split[5]);
-    const double spd = strtod(split[6].c_str(), nullptr);
-    const double hdg = strtod(split[7].c_str(), nullptr);
+void GnssReader::handleRmc(const NmeaSentence& sentence) {
+    const double lat = nmeaPositionToDecimal(sentence.field(2), sentence.field(3));
+    const double lon = nmeaPositionToDecimal(sentence.field(4), sentence.field(5));
+    const double spd = sentence.number(6) * 0.514444; //knots
+    const double hdg = sentence.number(7);
 
-    const auto ev = std::make_shared<GNSSPositionEvent>();
-    ev->constellation = constellationFromTalker(talker);
+    auto* ev = acquireEvent<GNSSPositionEvent>();
+    ev->constellation = constellationFromTalker(sentence.talker);
     ev->latitude = lat;
     ev->longitude = lon;
     ev->speed = spd;
     ev->heading = hdg;
+    ev->timeOfFix = nmeaTimeToSeconds(sentence.field(0));
     EventDispatcher::instance().dispatchAsync(ev);
 }
 
-void GnssReader::handleGga(const std::string& talker, const std::string& sentence) {
-    const auto split = splitString(sentence, ',');
-    //TOD - split[0]
-    const double lat = nmeaPositionToDecimal(split[1], split[2]);
-    const double lon = nmeaPositionToDecimal(split[3], split[4]);
-    const auto quality = static_cast<N183GNSSQualityIndicator>(strtoul(split[5].c_str(), nullptr, 10));
+void GnssReader::handleGga(const NmeaSentence& sentence) {
+    const double lat = nmeaPositionToDecimal(sentence.field(1), sentence.field(2));
+    const double lon = nmeaPositionToDecimal(sentence.field(3), sentence.field(4));
+    const auto quality = static_cast<N183GNSSQualityIndicator>(sentence.integer(5));
     const bool valid = quality != INVALID && quality != NA;
-    const unsigned int svs = strtoul(split[6].c_str(), nullptr, 10);
-    const double hdop = strtod(split[7].c_str(), nullptr);
-    const double height = strtod(split[8].c_str(), nullptr);
-    const double geoidSeparation = strtod(split[10].c_str(), nullptr);
+    const double hdop = sentence.number(7);
+    const double height = sentence.number(8);
 
     if (valid){
-        const auto ev = std::make_shared<GNSSPositionEvent>();
-        ev->constellation = constellationFromTalker(talker);
+        auto* ev = acquireEvent<GNSSPositionEvent>();
+        ev->constellation = constellationFromTalker(sentence.talker);
         ev->latitude = lat;
         ev->longitude = lon;
         ev->altitude = height;
         ev->hdop = hdop;
+        ev->timeOfFix = nmeaTimeToSeconds(sentence.field(0));
+        ev->fixQuality = fixQualityFromIndicator(quality);
         //TODO: Expand event to include sat count etc
         EventDispatcher::instance().dispatchAsync(ev);
     } else {
-        Logger::instance().warn("GnssReader", "Position not valid: " + talker + "Gga");
+        Logger::instance().warn("GnssReader", "Position not valid: " + std::string(sentence.address));
     }
 }
 
-void GnssReader::handleGsa(const std::string& talker, const std::string& sentence) {
+void GnssReader::handleGsa(const NmeaSentence& sentence) {
     //TODO: Check against real data and build from there
 }
 
-void GnssReader::handleGsv(const std::string& talker, const std::string& sentence) {
-    const auto constellation = constellationFromTalker(talker);
-    const auto split = splitString(sentence, ',');
-    const auto& msgCnt = split[0];
-    const auto& msgNo = split[1];
-    if (msgNo == "1") {
-        if (svBuffer_.contains(constellation)) {
-            svBuffer_[constellation].clear();
-        } else {
-            svBuffer_[constellation] = {};
-        }
+void GnssReader::handleGsv(const NmeaSentence& sentence) {
+    const auto constellation = constellationFromTalker(sentence.talker);
+    const long msgCnt = sentence.integer(0);
+    const long msgNo = sentence.integer(1);
+    auto& buffer = svBuffer_[constellation];
+    if (msgNo == 1) {
+        buffer.clear();
     }
-    for (int i = 3; i<split.size()-1; i+=4) {
+    for (size_t i = 3; i + 3 < sentence.fieldCount; i+=4) {
         GNSSSatelliteRecord record;
-        record.satelliteId = strtol(split[i].c_str(), nullptr, 10);
-        record.elevation = strtol(split[i+1].c_str(), nullptr, 10);
-        record.azimuth = strtol(split[i+2].c_str(), nullptr, 10);
-        record.snr = strtol(split[i+3].c_str(), nullptr, 10);
-        svBuffer_[constellation].push_back(record);
+        record.satelliteId = sentence.integer(i);
+        record.elevation = sentence.integer(i+1);
+        record.azimuth = sentence.integer(i+2);
+        record.snr = sentence.integer(i+3);
+        buffer.push_back(record);
     }
     if (msgCnt == msgNo) {
-        const auto ev = std::make_shared<GNSSSatellitesEvent>();
+        auto* ev = acquireEvent<GNSSSatellitesEvent>();
         ev->constellation = constellation;
-        ev->satsInView = svBuffer_[constellation].size();
-        ev->satellites = svBuffer_[constellation];
+        ev->satsInView = buffer.size();
+        ev->satellites = buffer;
         EventDispatcher::instance().dispatchAsync(ev);
     }
 
 }
 
-void GnssReader::handleGll(const std::string& talker, const std::string& sentence) {
-    const auto split = splitString(sentence, ',');
-    const double lat = nmeaPositionToDecimal(split[0], split[1]);
-    const double lon = nmeaPositionToDecimal(split[2], split[3]);
-    //TOD - split[4]
+void GnssReader::handleGll(const NmeaSentence& sentence) {
+    const double lat = nmeaPositionToDecimal(sentence.field(0), sentence.field(1));
+    const double lon = nmeaPositionToDecimal(sentence.field(2), sentence.field(3));
 
-    if (split[5] == "A"){
-        const auto ev = std::make_shared<GNSSPositionEvent>();
-        ev->constellation = constellationFromTalker(talker);
+    if (sentence.field(5) == "A"){
+        auto* ev = acquireEvent<GNSSPositionEvent>();
+        ev->constellation = constellationFromTalker(sentence.talker);
         ev->latitude = lat;
         ev->longitude = lon;
+        ev->timeOfFix = nmeaTimeToSeconds(sentence.field(4));
         EventDispatcher::instance().dispatchAsync(ev);
     } else {
-        Logger::instance().warn("GnssReader", "Position not valid: " + talker + "GLL");
+        Logger::instance().warn("GnssReader", "Position not valid: " + std::string(sentence.address));
     }
 }
 
-void GnssReader::handleVtg(const std::string& talker, const std::string& sentence) {
-    const auto split = splitString(sentence, ',');
-    const double trackDegTrue = strtod(split[0].c_str(), nullptr);
-    double trackDegMag = strtod(split[2].c_str(), nullptr);
-    double spdKts = strtod(split[4].c_str(), nullptr);
-    const double speedKph = strtod(split[6].c_str(), nullptr);
-    if (split[8] != "N") {
-        const auto ev = std::make_shared<GNSSPositionEvent>();
-        ev->constellation = constellationFromTalker(talker);
+void GnssReader::handleVtg(const NmeaSentence& sentence) {
+    const double trackDegTrue = sentence.number(0);
+    const double speedKph = sentence.number(6);
+    if (sentence.field(8) != "N") {
+        auto* ev = acquireEvent<GNSSPositionEvent>();
+        ev->constellation = constellationFromTalker(sentence.talker);
         ev->heading = trackDegTrue;
         ev->speed = speedKph*0.277778;
         EventDispatcher::instance().dispatchAsync(ev);
     } else {
-        Logger::instance().warn("GnssReader", "Course not valid: " + talker + "VTG");
+        Logger::instance().warn("GnssReader", "Course not valid: " + std::string(sentence.address));
     }
 }
 
-void GnssReader::handleTxt(const std::string& line) {
-    switch (const auto split = splitString(line, ','); stringHash(split[2].c_str())) {
+void GnssReader::handleTxt(const NmeaSentence& sentence) {
+    const std::string text(sentence.field(3));
+    switch (stringHash(sentence.field(2))) {
         case stringHash("00"): {
-            Logger::instance().error("GnssReader::handleTxt", split[3]);
+            Logger::instance().error("GnssReader::handleTxt", text);
             break;
         }
         case stringHash("01"): {
-            Logger::instance().warn("GnssReader::handleTxt", split[3]);
+            Logger::instance().warn("GnssReader::handleTxt", text);
             break;
         }
         case stringHash("02"):
         case stringHash("03"): {
-            Logger::instance().info("GnssReader::handleTxt", split[3]);
+            Logger::instance().info("GnssReader::handleTxt", text);
             break;
         }
         default:
-            Logger::instance().info("GnssReader::handleTxt", "Unknown Text message level " + split[3]);
+            Logger::instance().info("GnssReader::handleTxt", "Unknown Text message level " + text);
     }
 }
 
-GNSSSatelliteConstellation GnssReader::constellationFromTalker(const std::string& talker) {
-    switch (stringHash(talker.c_str())){
+GNSSSatelliteConstellation GnssReader::constellationFromTalker(const std::string_view talker) {
+    switch (stringHash(talker)){
         case stringHash("GN"):{
             return COMBINED;
         }
@@ -336,4 +562,56 @@ GNSSSatelliteConstellation GnssReader::constellationFromTalker(const std::string
     }
 }
 
+GNSSSatelliteConstellation GnssReader::constellationFromGnssId(const uint8_t gnssId) {
+    switch (gnssId) {
+        case 0:
+        //SBAS is reported alongside GPS, as it is in GPGSV
+        case 1:
+            return GPS;
+        case 2:
+            return GALILEO;
+        case 3:
+            return BEIDOU;
+        case 5:
+            return QZSS;
+        case 6:
+            return GLONASS;
+        case 7:
+            return NAVIC;
+        default:
+            return UNKNOWN;
+    }
+}
+
+GNSSFixQuality GnssReader::fixQualityFromIndicator(const N183GNSSQualityIndicator quality) {
+    switch (quality) {
+        case GNSS:
+            return FIX_GNSS;
+        case DGPS:
+            return FIX_DGNSS;
+        case RTK_FIXED:
+            return FIX_RTK_FIXED;
+        case RTK_FLOAT:
+            return FIX_RTK_FLOAT;
+        case INS_DR:
+            return FIX_DEAD_RECKONING;
+        default:
+            return FIX_UNKNOWN;
+    }
+}
 
+GNSSFixQuality GnssReader::fixQualityFromNavStat(const std::string_view navStat) {
+    switch (stringHash(navStat)) {
+        case stringHash("G2"):
+        case stringHash("G3"):
+        case stringHash("RK"):
+            return FIX_GNSS;
+        case stringHash("D2"):
+        case stringHash("D3"):
+            return FIX_DGNSS;
+        case stringHash("DR"):
+            return FIX_DEAD_RECKONING;
+        default:
+            return FIX_UNKNOWN;
+    }
+}
@@ -1,10 +1,14 @@
 #ifndef GNSSREADER_H
 #define GNSSREADER_H
+#include <array>
+#include <deque>
 #include <map>
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/serial_port.hpp>
-#include <boost/asio/streambuf.hpp>
-#include "../event/Event.h"
+#include "../event/EventDispatcher.h"
+#include "../utils/NMEAUtils.h"
+#include "../utils/RTCMUtils.h"
+#include "../utils/UBXUtils.h"
 
 enum N183GNSSQualityIndicator {
     INVALID = 0,
@@ -16,32 +20,72 @@ enum N183GNSSQualityIndicator {
     INS_DR
 };
 
-class GnssReader {
+///
+/// Reads a u-blox receiver on a serial port. NMEA sentences and UBX binary frames are both accepted on the same stream;
+/// when the configured gnssProtocol is UBX the receiver is switched to NAV-PVT/NAV-SAT/NAV-TIMEUTC output at the
+/// configured rate and its NMEA output is turned off.
+///
+/// RTK corrections arriving as RTKCorrectionEvents are written back to the receiver on the same port. Writes go through
+/// one queue, one async_write at a time, with observations ahead of station and descriptor messages. A correction
+/// waiting in the queue is replaced by a newer message of the same type, and one older than rtcmMaxAge by the time the
+/// port is free is dropped, since a stale correction only holds up the fresh ones behind it.
+///
+class GnssReader final : public EventListener {
 public:
     GnssReader(boost::asio::io_context &ioCtx, const std::string &port);
+    ~GnssReader() override;
+    ///
+    /// Runs raw receiver output through the same framing and decoding as bytes read from the serial port. Must be
+    /// called on the reader's io context; used to replay logs and by the benchmarks.
+    ///
+    void feed(std::string_view data);
 
 private:
+    struct PendingWrite {
+        std::vector<uint8_t> data;
+        uint16_t messageType = 0; //RTCM message type, 0 for our own configuration which is never dropped
+        unsigned long long received = 0;
+    };
+
     boost::asio::serial_port serialPort_;
+    std::array<std::deque<PendingWrite>, RTCM_PRIORITY_COUNT> writeQueue_;
+    PendingWrite writing_;
+    bool writeInFlight_ = false;
+    unsigned long long maxCorrectionAgeMs_;
+    unsigned long long correctionsWritten_ = 0;
+    unsigned long long correctionsDropped_ = 0;
 
     void readOperation();
     void readHandler(const boost::system::error_code &ec, std::size_t length);
-    void handlePacket(const std::string& line);
-    static bool validateChecksum(const std::string& line);
+    void processPending();
+    void handlePacket(std::string_view line);
+    void configureUbx(int rateHz);
+    void handleRtkCorrectionEvent(const RTKCorrectionEvent& ev);
+    void queueWrite(PendingWrite write, RtcmPriority priority);
+    void writeNext();
 
-    std::array<char, 1024> dataBuf_ = {};
-    boost::asio::streambuf buffer_;
+    std::array<char, 2048> dataBuf_ = {};
+    size_t pending_ = 0;
     std::map<GNSSSatelliteConstellation, std::vector<GNSSSatelliteRecord>> svBuffer_;
 
-    static void handleUbx(const std::string& sentence);
-    static void handleRmc(const std::string& talker, const std::string& sentence);
-    static void handleGga(const std::string& talker, const std::string& sentence);
-    static void handleGsa(const std::string& talker, const std::string& sentence);
-    void handleGsv(const std::string& talker, const std::string& sentence);
-    static void handleGll(const std::string& talker, const std::string& sentence);
-    static void handleVtg(const std::string& talker, const std::string& sentence);
-    static void handleTxt(const std::string &line);
+    static void handleUbx(const NmeaSentence& sentence);
+    static void handleRmc(const NmeaSentence& sentence);
+    static void handleGga(const NmeaSentence& sentence);
+    static void handleGsa(const NmeaSentence& sentence);
+    void handleGsv(const NmeaSentence& sentence);
+    static void handleGll(const NmeaSentence& sentence);
+    static void handleVtg(const NmeaSentence& sentence);
+    static void handleTxt(const NmeaSentence& sentence);
+
+    void handleUbxFrame(const UbxFrame& frame);
+    static void handleNavPvt(const UbxFrame& frame);
+    void handleNavSat(const UbxFrame& frame);
+    static void handleNavTimeUtc(const UbxFrame& frame);
 
-    static GNSSSatelliteConstellation constellationFromTalker(const std::string &talker);
+    static GNSSSatelliteConstellation constellationFromTalker(std::string_view talker);
+    static GNSSSatelliteConstellation constellationFromGnssId(uint8_t gnssId);
+    static GNSSFixQuality fixQualityFromIndicator(N183GNSSQualityIndicator quality);
+    static GNSSFixQuality fixQualityFromNavStat(std::string_view navStat);
 };
 
 
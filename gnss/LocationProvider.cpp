@@ -1,58 +1,145 @@
 #include "LocationProvider.h"
-LocationProvider::LocationProvider(boost::asio::io_context& ctx): timer_(ctx) {
-	EventDispatcher::instance().subscribe(GNSS_POSITION, this);
-	EventDispatcher::instance().subscribe(GNSS_SATELLITES, this);
-	EventDispatcher::instance().subscribe(GNSS_TOD, this);
-	timer_.expires_after(boost::asio::chrono::milliseconds(100));
-	timer_.async_wait([&](const boost::system::error_code& ec) {
-		timeout(ec);
-	});
+
+#include "../config/ConfigProvider.h"
+#include "../logging/Logger.h"
+#include "../utils/TimeUtils.h"
+
+//Event members in PositionField order
+static constexpr double GNSSPositionEvent::* GNSS_EVENT_FIELDS[POSITION_FIELD_COUNT] = {
+	&GNSSPositionEvent::latitude, &GNSSPositionEvent::longitude, &GNSSPositionEvent::altitude,
+	&GNSSPositionEvent::hAccuracy, &GNSSPositionEvent::vAccuracy, &GNSSPositionEvent::speed,
+	&GNSSPositionEvent::heading, &GNSSPositionEvent::vVelocity, &GNSSPositionEvent::correctionAge,
+	&GNSSPositionEvent::hdop
+};
+static constexpr double PositionEvent::* POSITION_EVENT_FIELDS[POSITION_FIELD_COUNT] = {
+	&PositionEvent::latitude, &PositionEvent::longitude, &PositionEvent::altitude,
+	&PositionEvent::hAccuracy, &PositionEvent::vAccuracy, &PositionEvent::speed,
+	&PositionEvent::heading, &PositionEvent::vVelocity, &PositionEvent::correctionAge,
+	&PositionEvent::hdop
+};
+
+LocationProvider::LocationProvider(boost::asio::io_context& ctx): timer_(ctx), watchdog_(ctx), outputTimer_(ctx),
+	epochTimer_(ctx) {
+	const ConfigProvider& config = ConfigProvider::instance();
+	epochMode_ = config.positionPublishMode() != "TIMER";
+	minIntervalMs_ = config.positionMaxRate() > 0 ? 1000 / config.positionMaxRate() : 0;
+	fixTimeoutMs_ = config.positionFixTimeout();
+	filterEnabled_ = config.positionFilter();
+	outputIntervalMs_ = filterEnabled_ && config.positionOutputRate() > 0 ? 1000 / config.positionOutputRate() : 0;
+	if (outputIntervalMs_ > 0) {
+		Logger::instance().info("LocationProvider", "Publishing filtered position every " +
+			std::to_string(outputIntervalMs_) + "ms");
+	} else {
+		Logger::instance().info("LocationProvider", std::string("Publishing ") + (filterEnabled_ ? "filtered " : "") +
+			"position " + (epochMode_ ? "on each epoch" : "every 100ms"));
+	}
+
+	std::lock_guard lock(lock_);
+	EventDispatcher::instance().subscribe<&LocationProvider::handleGnssPositionEvent>(this);
+	EventDispatcher::instance().subscribe<&LocationProvider::handleGnssSatellitesEvent>(this);
+	EventDispatcher::instance().subscribe<&LocationProvider::handleGnssTodEvent>(this);
+	if (outputIntervalMs_ > 0) {
+		epochMode_ = false;
+		outputTimer_.expires_after(boost::asio::chrono::milliseconds(outputIntervalMs_));
+		outputTimer_.async_wait([&](const boost::system::error_code& ec) {
+			outputTimeout(ec);
+		});
+	} else if (!epochMode_) {
+		timer_.expires_after(boost::asio::chrono::milliseconds(100));
+		timer_.async_wait([&](const boost::system::error_code& ec) {
+			timeout(ec);
+		});
+	}
+	armWatchdog();
 }
 
 LocationProvider::~LocationProvider() {
-	EventDispatcher::instance().unsubscribe(GNSS_POSITION, this);
-	EventDispatcher::instance().unsubscribe(GNSS_SATELLITES, this);
-	EventDispatcher::instance().unsubscribe(GNSS_TOD, this);
-}
-
-void LocationProvider::notifyMessage(const std::shared_ptr<Event> ev) {
-	switch (ev->eventType()) {
-		case GNSS_POSITION:
-			handleGnssPositionEvent(std::dynamic_pointer_cast<GNSSPositionEvent>(ev));
-			break;
-		case GNSS_SATELLITES:
-			handleGnssSatellitesEvent(ev);
-			break;
-		case GNSS_TOD:
-			handleGnssTodEvent(ev);
-			break;
-		default:
-			//noop
-			break;
-	}
-}
-
-LocationSourceEntry* LocationProvider::fixIsValid() {
-	for (auto & locationSource : locationSources_) {
-		//TODO: Make this more sophisticated
-		if (!std::isnan(locationSource.latitude) && !std::isnan(locationSource.longitude)) {
-			return &locationSource;
+	EventDispatcher::instance().unsubscribe(this);
+}
+
+double LocationProvider::estimatedError(const LocationSourceEntry& src, const unsigned long long now) {
+	const unsigned long long age = now - src.fieldUpdated[FIELD_LATITUDE];
+	if (std::isnan(src.values[FIELD_LATITUDE]) || std::isnan(src.values[FIELD_LONGITUDE]) || age > SOURCE_STALE_MS) {
+		return INFINITY;
+	}
+	//Nominal horizontal error for each fix quality when the receiver does not give us an accuracy estimate
+	static constexpr double QUALITY_ERROR[] = {5.0, 20.0, 2.5, 1.0, 0.3, 0.02};
+	double error = src.values[FIELD_H_ACCURACY];
+	if (std::isnan(error)) {
+		const double hdop = src.values[FIELD_HDOP];
+		error = QUALITY_ERROR[src.quality] * (std::isnan(hdop) ? 1.0 : std::max(hdop, 1.0));
+	}
+	//Corrections degrade as they age, a minute old RTK fix is not a centimetre fix any more
+	if (const double correctionAge = src.values[FIELD_CORRECTION_AGE]; !std::isnan(correctionAge) && correctionAge > 10) {
+		error *= correctionAge / 10;
+	}
+	//How far we could have moved since this source last reported
+	const double speed = src.values[FIELD_SPEED];
+	error += (std::isnan(speed) ? 1.0 : std::max(speed, 1.0)) * age / 1000.0;
+	if (now < src.inconsistentUntil) {
+		error *= 10;
+	}
+	return error;
+}
+
+LocationSourceEntry* LocationProvider::selectSource(const unsigned long long now) {
+	LocationSourceEntry* current = nullptr;
+	LocationSourceEntry* best = nullptr;
+	double currentError = INFINITY;
+	double bestError = INFINITY;
+	for (auto& locationSource : locationSources_) {
+		const double error = estimatedError(locationSource, now);
+		if (hasSelection_ && locationSource.source == selectedSource_) {
+			current = &locationSource;
+			currentError = error;
+		}
+		if (error < bestError) {
+			best = &locationSource;
+			bestError = error;
+		}
+	}
+	if (best == nullptr) {
+		return nullptr;
+	}
+	SourceSelectionReason reason = SELECTION_NONE;
+	if (!hasSelection_) {
+		reason = SELECTION_INITIAL;
+	} else if (std::isinf(currentError)) {
+		reason = SELECTION_FAILOVER;
+	} else if (best != current && bestError < currentError * SOURCE_SWITCH_RATIO) {
+		//Hysteresis, the challenger has to stay clearly better before we move to it
+		if (best->betterSince == 0) {
+			best->betterSince = now;
+		} else if (now - best->betterSince >= SOURCE_SWITCH_HOLD_MS) {
+			reason = SELECTION_BETTER_ACCURACY;
+		}
+	}
+	for (auto& locationSource : locationSources_) {
+		if (&locationSource != best || reason != SELECTION_NONE) {
+			locationSource.betterSince = 0;
 		}
 	}
-	return nullptr;
+	if (reason == SELECTION_NONE) {
+		return current;
+	}
+	Logger::instance().info("LocationProvider", "Selected " + std::string(best->source == N2K ? "N2K" : "USB") +
+		" source (" + (reason == SELECTION_INITIAL ? "initial" : reason == SELECTION_FAILOVER ? "failover" : "better accuracy") +
+		"), estimated error " + std::to_string(bestError) + "m");
+	hasSelection_ = true;
+	selectedSource_ = best->source;
+	selectionReason_ = reason;
+	return best;
 }
 
 void LocationProvider::timeout(const boost::system::error_code& ec) {
-	//TODO: Error handling
+	if (ec == boost::asio::error::operation_aborted) {
+		return;
+	}
+	std::lock_guard lock(lock_);
 	//Work out if we have a valid GPS fix and send a packet to N2K, influx and MDSS if we do
-	if (const LocationSourceEntry* src = fixIsValid()) {
-		const auto ev = std::make_shared<PositionEvent>();
-		ev->latitude = src->latitude;
-		ev->longitude = src->longitude;
-		ev->altitude = src->altitude;
-		ev->speed = src->speed;
-		ev->heading = src->heading;
-		EventDispatcher::instance().dispatchAsync(ev);
+	const unsigned long long now = systemTimeMillis();
+	if (LocationSourceEntry* src = selectSource(now); src && src->publishedEpoch != src->epochCount) {
+		publish(*src, now);
 	}
 	timer_.expires_from_now(boost::asio::chrono::milliseconds(100));
 	timer_.async_wait([&](const boost::system::error_code& ec) {
@@ -60,6 +147,146 @@ void LocationProvider::timeout(const boost::system::error_code& ec) {
 	});
 }
 
+void LocationProvider::deferredTimeout(const boost::system::error_code& ec) {
+	if (ec == boost::asio::error::operation_aborted) {
+		return;
+	}
+	std::lock_guard lock(lock_);
+	publishDeferred_ = false;
+	publishLatest(systemTimeMillis());
+}
+
+void LocationProvider::watchdogTimeout(const boost::system::error_code& ec) {
+	if (ec == boost::asio::error::operation_aborted) {
+		return;
+	}
+	std::lock_guard lock(lock_);
+	if (fixLost_) {
+		return;
+	}
+	fixLost_ = true;
+	Logger::instance().warn("LocationProvider", "No fix published for " + std::to_string(fixTimeoutMs_) + "ms");
+	auto* ev = acquireEvent<PositionEvent>();
+	ev->fixValid = false;
+	EventDispatcher::instance().dispatchAsync(ev);
+}
+
+void LocationProvider::outputTimeout(const boost::system::error_code& ec) {
+	if (ec == boost::asio::error::operation_aborted) {
+		return;
+	}
+	std::lock_guard lock(lock_);
+	//The filter keeps predicting between fixes and through outages up to FILTER_MAX_COAST_MS
+	const unsigned long long now = systemTimeMillis();
+	if (LocationSourceEntry* src = selectSource(now); src && filter_.initialised()) {
+		publish(*src, now);
+	}
+	outputTimer_.expires_at(outputTimer_.expiry() + boost::asio::chrono::milliseconds(outputIntervalMs_));
+	outputTimer_.async_wait([&](const boost::system::error_code& ec) {
+		outputTimeout(ec);
+	});
+}
+
+void LocationProvider::epochTimeout(const boost::system::error_code& ec) {
+	if (ec == boost::asio::error::operation_aborted) {
+		return;
+	}
+	std::lock_guard lock(lock_);
+	epochTimerArmed_ = false;
+	//Close every epoch whose source has gone quiet, and come back for any that is still being sent
+	const unsigned long long now = systemTimeMillis();
+	bool closed = false;
+	unsigned long long nextDue = 0;
+	for (auto& locationSource : locationSources_) {
+		if (locationSource.pending.fieldsSet == 0) {
+			continue;
+		}
+		if (const unsigned long long quiet = now - locationSource.pending.lastUpdate; quiet >= EPOCH_QUIET_MS) {
+			closeEpoch(locationSource, now);
+			updateFilter(locationSource, now);
+			closed = true;
+		} else if (nextDue == 0 || EPOCH_QUIET_MS - quiet < nextDue) {
+			nextDue = EPOCH_QUIET_MS - quiet;
+		}
+	}
+	if (nextDue != 0) {
+		armEpochTimer(nextDue);
+	}
+	if (closed && epochMode_) {
+		publishLatest(now);
+	}
+}
+
+void LocationProvider::armEpochTimer(const unsigned long long delayMs) {
+	if (epochTimerArmed_) {
+		return;
+	}
+	epochTimerArmed_ = true;
+	epochTimer_.expires_after(boost::asio::chrono::milliseconds(delayMs));
+	epochTimer_.async_wait([&](const boost::system::error_code& ec) {
+		epochTimeout(ec);
+	});
+}
+
+void LocationProvider::armWatchdog() {
+	if (fixTimeoutMs_ == 0) {
+		return;
+	}
+	watchdog_.expires_after(boost::asio::chrono::milliseconds(fixTimeoutMs_));
+	watchdog_.async_wait([&](const boost::system::error_code& ec) {
+		watchdogTimeout(ec);
+	});
+}
+
+void LocationProvider::publishLatest(const unsigned long long now) {
+	LocationSourceEntry* src = selectSource(now);
+	if (!src || src->publishedEpoch == src->epochCount) {
+		return;
+	}
+	if (now - lastPublished_ >= minIntervalMs_) {
+		publish(*src, now);
+	} else if (!publishDeferred_) {
+		//Too soon after the last one, publish whatever is latest once the interval is up
+		publishDeferred_ = true;
+		timer_.expires_after(boost::asio::chrono::milliseconds(minIntervalMs_ - (now - lastPublished_)));
+		timer_.async_wait([&](const boost::system::error_code& ec) {
+			deferredTimeout(ec);
+		});
+	}
+}
+
+void LocationProvider::publish(LocationSourceEntry& src, const unsigned long long now) {
+	FilteredPosition filtered;
+	if (filterEnabled_ && !filter_.estimate(now, filtered)) {
+		return;
+	}
+	auto* ev = acquireEvent<PositionEvent>();
+	for (size_t i = 0; i < POSITION_FIELD_COUNT; i++) {
+		ev->*POSITION_EVENT_FIELDS[i] = src.values[i];
+	}
+	if (filterEnabled_) {
+		ev->latitude = filtered.latitude;
+		ev->longitude = filtered.longitude;
+		ev->altitude = filtered.altitude;
+		ev->hAccuracy = filtered.hAccuracy;
+		ev->vAccuracy = filtered.vAccuracy;
+		ev->speed = filtered.speed;
+		ev->heading = filtered.heading;
+		ev->vVelocity = filtered.vVelocity;
+	}
+	ev->source = src.source;
+	ev->fixQuality = src.quality;
+	ev->selectionReason = selectionReason_;
+	src.publishedEpoch = src.epochCount;
+	lastPublished_ = now;
+	if (fixLost_) {
+		Logger::instance().info("LocationProvider", "Fix regained");
+		fixLost_ = false;
+	}
+	armWatchdog();
+	EventDispatcher::instance().dispatchAsync(ev);
+}
+
 LocationSourceEntry* LocationProvider::getOrCreateSource(const GNSSSource source) {
 	for (auto& locationSource : locationSources_) {
 		if (locationSource.source == source) {
@@ -72,23 +299,101 @@ LocationSourceEntry* LocationProvider::getOrCreateSource(const GNSSSource source
 	return &locationSources_.back();
 }
 
-void LocationProvider::handleGnssPositionEvent(const std::shared_ptr<GNSSPositionEvent>& ev) {
-	LocationSourceEntry* src = getOrCreateSource(ev->source);
-	src->latitude = ev->latitude;
-	src->longitude = ev->longitude;
-	src->altitude = ev->altitude;
-	if (!std::isnan(ev->speed)) {
-		src->speed = ev->speed;
+void LocationProvider::closeEpoch(LocationSourceEntry& src, const unsigned long long now) {
+	//Self-consistency, a new position should be within reach of the last one given speed and accuracy
+	if (src.pending.fieldsSet & 1U << FIELD_LATITUDE && !std::isnan(src.values[FIELD_LATITUDE])) {
+		const double lat = src.pending.values[FIELD_LATITUDE];
+		const double dLat = (lat - src.values[FIELD_LATITUDE]) * M_PI / 180.0;
+		const double dLon = (src.pending.values[FIELD_LONGITUDE] - src.values[FIELD_LONGITUDE]) * M_PI / 180.0 *
+			std::cos(lat * M_PI / 180.0);
+		const double jump = 6371000.0 * std::sqrt(dLat * dLat + dLon * dLon);
+		const double speed = std::isnan(src.values[FIELD_SPEED]) ? 30.0 : src.values[FIELD_SPEED];
+		const double accuracy = std::isnan(src.values[FIELD_H_ACCURACY]) ? 10.0 : src.values[FIELD_H_ACCURACY];
+		const double dt = (now - src.fieldUpdated[FIELD_LATITUDE]) / 1000.0;
+		if (jump > speed * 1.5 * dt + 3 * accuracy + 5.0) {
+			LOG_DEBUG("LocationProvider", "Position jumped " + std::to_string(jump) + "m");
+			src.inconsistentUntil = now + SOURCE_JUMP_PENALTY_MS;
+		}
+	}
+	for (size_t i = 0; i < POSITION_FIELD_COUNT; i++) {
+		if (src.pending.fieldsSet & 1U << i) {
+			src.values[i] = src.pending.values[i];
+			src.fieldUpdated[i] = now;
+		} else if (now - src.fieldUpdated[i] > POSITION_FIELD_STALE_MS) {
+			src.values[i] = NAN;
+		}
+	}
+	src.timeOfFix = src.pending.timeOfFix;
+	if (src.pending.quality != FIX_UNKNOWN) {
+		src.quality = src.pending.quality;
+	}
+	src.epochCount++;
+	src.pending = GnssEpoch();
+}
+
+void LocationProvider::handleGnssPositionEvent(const GNSSPositionEvent& ev) {
+	std::lock_guard lock(lock_);
+	LocationSourceEntry* src = getOrCreateSource(ev.source);
+	const unsigned long long now = systemTimeMillis();
+	const unsigned long long epochsBefore = src->epochCount;
+	src->lastSeen = now;
+	//A sentence stamped with a different time of fix means the receiver has moved on to the next epoch, so the one
+	//we were assembling is complete. Sentences without a time (VTG) join whichever epoch is open.
+	if (src->pending.fieldsSet != 0) {
+		const bool newEpoch = !std::isnan(ev.timeOfFix) && !std::isnan(src->pending.timeOfFix) &&
+			std::abs(src->pending.timeOfFix - ev.timeOfFix) > 0.0005;
+		if (newEpoch || now - src->pending.started > EPOCH_TIMEOUT_MS) {
+			closeEpoch(*src, now);
+		}
 	}
-	if (!std::isnan(ev->heading)) {
-		src->heading = ev->heading;
+	if (src->pending.fieldsSet == 0) {
+		src->pending.started = now;
+	}
+	src->pending.lastUpdate = now;
+	if (!std::isnan(ev.timeOfFix)) {
+		src->pending.timeOfFix = ev.timeOfFix;
+	}
+	for (size_t i = 0; i < POSITION_FIELD_COUNT; i++) {
+		if (const double value = ev.*GNSS_EVENT_FIELDS[i]; !std::isnan(value)) {
+			src->pending.values[i] = value;
+			src->pending.fieldsSet |= 1U << i;
+		}
+	}
+	if (ev.fixQuality != FIX_UNKNOWN) {
+		src->pending.quality = ev.fixQuality;
+	}
+	if (ev.epochComplete) {
+		closeEpoch(*src, now);
+	} else if (src->pending.fieldsSet != 0) {
+		//NMEA has no end of epoch marker, the burst ending is the closest we get
+		armEpochTimer(EPOCH_QUIET_MS);
+	}
+	if (src->epochCount != epochsBefore) {
+		updateFilter(*src, now);
+	}
+	if (epochMode_) {
+		publishLatest(now);
+	}
+}
+
+void LocationProvider::updateFilter(LocationSourceEntry& src, const unsigned long long now) {
+	//Only the selected source feeds the filter, and only with whole epochs
+	if (!filterEnabled_ || selectSource(now) != &src) {
+		return;
 	}
+	//Fields carried forward from earlier epochs have already been seen by the filter
+	const auto fresh = [&](const PositionField field) {
+		return src.fieldUpdated[field] == now ? src.values[field] : NAN;
+	};
+	filter_.update(now, fresh(FIELD_LATITUDE), fresh(FIELD_LONGITUDE), fresh(FIELD_ALTITUDE),
+		src.values[FIELD_H_ACCURACY], src.values[FIELD_V_ACCURACY], fresh(FIELD_SPEED), fresh(FIELD_HEADING),
+		fresh(FIELD_V_VELOCITY));
 }
 
-void LocationProvider::handleGnssSatellitesEvent(const std::shared_ptr<Event>& ev) {
+void LocationProvider::handleGnssSatellitesEvent(const GNSSSatellitesEvent& ev) {
 
 }
 
-void LocationProvider::handleGnssTodEvent(const std::shared_ptr<Event>& ev) {
+void LocationProvider::handleGnssTodEvent(const GNSSTodEvent& ev) {
 
 }
@@ -1,42 +1,133 @@
 #ifndef LOCATIONPROVIDER_H
 #define LOCATIONPROVIDER_H
+#include <array>
+#include <mutex>
 #include <boost/asio/steady_timer.hpp>
 
+#include "PositionFilter.h"
 #include "../event/EventDispatcher.h"
 //TODO: Expand for multi-constellation analysis
 
+enum PositionField {
+	FIELD_LATITUDE = 0,
+	FIELD_LONGITUDE,
+	FIELD_ALTITUDE,
+	FIELD_H_ACCURACY,
+	FIELD_V_ACCURACY,
+	FIELD_SPEED,
+	FIELD_HEADING,
+	FIELD_V_VELOCITY,
+	FIELD_CORRECTION_AGE,
+	FIELD_HDOP,
+	POSITION_FIELD_COUNT
+};
+
+//A field that has not been reported by any epoch for this long is dropped from the fix
+static constexpr unsigned long long POSITION_FIELD_STALE_MS = 2000;
+//Sources that never stamp a time of fix still get an epoch closed this often
+static constexpr unsigned long long EPOCH_TIMEOUT_MS = 1000;
+//Receivers send an epoch's sentences in one burst, so an epoch is complete once its source has been quiet this long
+static constexpr unsigned long long EPOCH_QUIET_MS = 50;
+//A source whose position has not been updated for this long cannot be selected
+static constexpr unsigned long long SOURCE_STALE_MS = 2000;
+//Another source must be estimated this much more accurate than the selected one, for this long, before we switch
+static constexpr double SOURCE_SWITCH_RATIO = 0.5;
+static constexpr unsigned long long SOURCE_SWITCH_HOLD_MS = 3000;
+//A source that jumps further than it could have travelled is distrusted for this long
+static constexpr unsigned long long SOURCE_JUMP_PENALTY_MS = 5000;
+
+///
+/// Everything a source has reported for one UTC time of fix. Sentences are merged in as they arrive and only the
+/// fields they actually carry are taken, so a GLL does not wipe out the altitude from the GGA before it.
+///
+struct GnssEpoch {
+	GnssEpoch() { values.fill(NAN); }
+	double timeOfFix = NAN;
+	unsigned long long started = 0;
+	unsigned long long lastUpdate = 0;
+	std::array<double, POSITION_FIELD_COUNT> values;
+	uint16_t fieldsSet = 0;
+	GNSSFixQuality quality = FIX_UNKNOWN;
+};
+
 struct LocationSourceEntry {
+	LocationSourceEntry() { values.fill(NAN); }
 	GNSSSource source;
-	unsigned long long lastSeen;
-	double latitude = NAN;
-	double longitude = NAN;
-	double altitude = NAN;
-	double hAccuracy = NAN;
-	double vAccuracy = NAN;
-	double speed = NAN;
-	double heading = NAN;
-	double vVelocity = NAN;
-	double correctionAge = NAN;
-	double hdop = NAN;
+	unsigned long long lastSeen = 0;
+	//Epoch currently being assembled
+	GnssEpoch pending;
+	//Merged fix from the last completed epoch, with each field's last update time
+	double timeOfFix = NAN;
+	std::array<double, POSITION_FIELD_COUNT> values;
+	std::array<unsigned long long, POSITION_FIELD_COUNT> fieldUpdated = {};
+	GNSSFixQuality quality = FIX_UNKNOWN;
+	unsigned long long epochCount = 0;
+	unsigned long long publishedEpoch = 0;
+	//Set when the last epoch jumped further than the source's own accuracy and speed allow
+	unsigned long long inconsistentUntil = 0;
+	//When this source first scored better than the selected one in its current run, 0 when it has not
+	unsigned long long betterSince = 0;
 	//TODO: Add sats in view
 };
 
+///
+/// Fuses GNSS input into a single fix and publishes it as PositionEvents. In EPOCH mode a fix is published as soon as
+/// its epoch completes, no faster than positionMaxRate; in TIMER mode the latest fix is polled every 100ms. Either way
+/// a PositionEvent with fixValid cleared is published if no fix has been published for positionFixTimeout ms.
+///
+/// When more than one source is reporting, each is scored by an estimate of its horizontal error in metres built from
+/// its reported accuracy or fix quality, correction age, data age and self-consistency. The selected source is kept
+/// until it goes stale or another source has been clearly better for SOURCE_SWITCH_HOLD_MS.
+///
+/// With positionFilter set, fixes from the selected source are run through a constant velocity Kalman filter and the
+/// filtered position is published instead. positionOutputRate then publishes the filter's prediction at a fixed rate,
+/// which also carries the position through short outages, in place of the publication mode above.
+///
 class LocationProvider final: public EventListener {
 public:
 	explicit LocationProvider(boost::asio::io_context& ctx);
 	~LocationProvider();
 
-	void notifyMessage(std::shared_ptr<Event> ev) override;
+	[[nodiscard]] bool serialized() const override { return true; }
 
 private:
 	boost::asio::steady_timer timer_;
+	boost::asio::steady_timer watchdog_;
+	boost::asio::steady_timer outputTimer_;
+	boost::asio::steady_timer epochTimer_;
+	//Event handlers run on the dispatcher, timers on the io context
+	std::mutex lock_;
+	bool epochMode_;
+	bool filterEnabled_;
+	unsigned long long outputIntervalMs_;
+	PositionFilter filter_;
+	unsigned long long minIntervalMs_;
+	unsigned long long fixTimeoutMs_;
+	unsigned long long lastPublished_ = 0;
+	bool publishDeferred_ = false;
+	bool epochTimerArmed_ = false;
+	bool fixLost_ = false;
+	bool hasSelection_ = false;
+	GNSSSource selectedSource_ = USB;
+	SourceSelectionReason selectionReason_ = SELECTION_NONE;
 
-	LocationSourceEntry* fixIsValid();
+	LocationSourceEntry* selectSource(unsigned long long now);
+	static double estimatedError(const LocationSourceEntry& src, unsigned long long now);
 	void timeout(const boost::system::error_code& ec);
+	void deferredTimeout(const boost::system::error_code& ec);
+	void watchdogTimeout(const boost::system::error_code& ec);
+	void outputTimeout(const boost::system::error_code& ec);
+	void epochTimeout(const boost::system::error_code& ec);
+	void armEpochTimer(unsigned long long delayMs);
+	void armWatchdog();
+	void publishLatest(unsigned long long now);
+	void publish(LocationSourceEntry& src, unsigned long long now);
 	LocationSourceEntry* getOrCreateSource(GNSSSource source);
-	void handleGnssPositionEvent(const std::shared_ptr<GNSSPositionEvent>& ev);
-	void handleGnssSatellitesEvent(const std::shared_ptr<Event>& ev);
-	void handleGnssTodEvent(const std::shared_ptr<Event>& ev);
+	static void closeEpoch(LocationSourceEntry& src, unsigned long long now);
+	void updateFilter(LocationSourceEntry& src, unsigned long long now);
+	void handleGnssPositionEvent(const GNSSPositionEvent& ev);
+	void handleGnssSatellitesEvent(const GNSSSatellitesEvent& ev);
+	void handleGnssTodEvent(const GNSSTodEvent& ev);
 	std::vector<LocationSourceEntry> locationSources_;
 };
 
@@ -0,0 +1,224 @@
+#ifndef POSITIONFILTER_H
+#define POSITIONFILTER_H
+#include <algorithm>
+#include <cmath>
+
+//Process noise, how hard we expect the boat to accelerate (m/s^2, one sigma)
+static constexpr double FILTER_HORIZONTAL_ACCEL = 1.0;
+static constexpr double FILTER_VERTICAL_ACCEL = 0.5;
+//Measurement noise used when the source does not report its accuracy (m and m/s, one sigma)
+static constexpr double FILTER_DEFAULT_H_ACCURACY = 5.0;
+static constexpr double FILTER_DEFAULT_V_ACCURACY = 10.0;
+static constexpr double FILTER_VELOCITY_ACCURACY = 0.5;
+//How long the filter will keep predicting without a measurement before it gives up
+static constexpr unsigned long long FILTER_MAX_COAST_MS = 5000;
+//The local tangent plane is moved once the boat is this far from its origin, to keep the flat earth error small
+static constexpr double FILTER_REANCHOR_DISTANCE = 5000.0;
+static constexpr double EARTH_RADIUS = 6371000.0;
+
+///
+/// Constant velocity Kalman filter along a single axis. State is position and velocity, so every matrix is 2x2 and is
+/// written out by hand.
+///
+struct KalmanAxis {
+	double position = 0;
+	double velocity = 0;
+	double p00 = 0;
+	double p01 = 0;
+	double p11 = 0;
+
+	void initialise(const double z, const double variance) {
+		position = z;
+		velocity = 0;
+		p00 = variance;
+		p01 = 0;
+		p11 = 100;
+	}
+
+	void predict(const double dt, const double accelVariance) {
+		const double dt2 = dt * dt;
+		position += velocity * dt;
+		p00 += 2 * dt * p01 + dt2 * p11 + accelVariance * dt2 * dt2 / 4;
+		p01 += dt * p11 + accelVariance * dt2 * dt / 2;
+		p11 += accelVariance * dt2;
+	}
+
+	void updatePosition(const double z, const double variance) {
+		const double s = p00 + variance;
+		const double k0 = p00 / s;
+		const double k1 = p01 / s;
+		const double y = z - position;
+		position += k0 * y;
+		velocity += k1 * y;
+		p11 -= k1 * p01;
+		p00 -= k0 * p00;
+		p01 -= k0 * p01;
+	}
+
+	void updateVelocity(const double z, const double variance) {
+		const double s = p11 + variance;
+		const double k0 = p01 / s;
+		const double k1 = p11 / s;
+		const double y = z - velocity;
+		position += k0 * y;
+		velocity += k1 * y;
+		p00 -= k0 * p01;
+		p01 -= k0 * p11;
+		p11 -= k1 * p11;
+	}
+};
+
+struct FilteredPosition {
+	double latitude = NAN;
+	double longitude = NAN;
+	double altitude = NAN;
+	double hAccuracy = NAN;
+	double vAccuracy = NAN;
+	double speed = NAN;
+	double heading = NAN;
+	double vVelocity = NAN;
+};
+
+///
+/// Smooths fixes with a constant velocity model in a local east/north/up plane. With a constant velocity model and
+/// independent noise on each axis the three axes do not interact, so the filter is three 2-state filters rather than
+/// one 6-state one. Nothing here allocates.
+///
+class PositionFilter {
+public:
+	[[nodiscard]] bool initialised() const { return initialised_; }
+
+	void reset() {
+		initialised_ = false;
+	}
+
+	///
+	/// Feeds one fix into the filter. Any value may be NaN; position needs both latitude and longitude, velocity needs
+	/// both speed and heading.
+	///
+	void update(const unsigned long long now, const double latitude, const double longitude, const double altitude,
+				const double hAccuracy, const double vAccuracy, const double speed, const double heading,
+				const double vVelocity) {
+		const bool hasPosition = !std::isnan(latitude) && !std::isnan(longitude);
+		if (initialised_ && now - lastUpdate_ > FILTER_MAX_COAST_MS) {
+			initialised_ = false;
+		}
+		if (!initialised_) {
+			if (!hasPosition) {
+				return;
+			}
+			setOrigin(latitude, longitude);
+			const double hVar = variance(hAccuracy, FILTER_DEFAULT_H_ACCURACY);
+			east_.initialise(0, hVar);
+			north_.initialise(0, hVar);
+			up_.initialise(std::isnan(altitude) ? 0 : altitude, variance(vAccuracy, FILTER_DEFAULT_V_ACCURACY));
+			hasAltitude_ = !std::isnan(altitude);
+			initialised_ = true;
+			lastUpdate_ = now;
+		} else {
+			predictTo(now);
+		}
+		if (hasPosition) {
+			const double hVar = variance(hAccuracy, FILTER_DEFAULT_H_ACCURACY);
+			east_.updatePosition(toEast(longitude), hVar);
+			north_.updatePosition(toNorth(latitude), hVar);
+		}
+		if (!std::isnan(altitude)) {
+			if (hasAltitude_) {
+				up_.updatePosition(altitude, variance(vAccuracy, FILTER_DEFAULT_V_ACCURACY));
+			} else {
+				up_.initialise(altitude, variance(vAccuracy, FILTER_DEFAULT_V_ACCURACY));
+				hasAltitude_ = true;
+			}
+		}
+		if (!std::isnan(speed) && !std::isnan(heading)) {
+			const double velVar = FILTER_VELOCITY_ACCURACY * FILTER_VELOCITY_ACCURACY;
+			const double hdg = heading * M_PI / 180.0;
+			east_.updateVelocity(speed * std::sin(hdg), velVar);
+			north_.updateVelocity(speed * std::cos(hdg), velVar);
+		}
+		if (!std::isnan(vVelocity)) {
+			up_.updateVelocity(vVelocity, FILTER_VELOCITY_ACCURACY * FILTER_VELOCITY_ACCURACY);
+		}
+		if (std::hypot(east_.position, north_.position) > FILTER_REANCHOR_DISTANCE) {
+			reanchor();
+		}
+	}
+
+	///
+	/// Extrapolates the state to now without changing it, so it can be called at any rate between fixes. Returns false
+	/// when the filter has no state or has been coasting for longer than FILTER_MAX_COAST_MS.
+	///
+	bool estimate(const unsigned long long now, FilteredPosition& out) const {
+		if (!initialised_ || now - lastUpdate_ > FILTER_MAX_COAST_MS) {
+			return false;
+		}
+		const double dt = now > lastUpdate_ ? (now - lastUpdate_) / 1000.0 : 0.0;
+		KalmanAxis east = east_;
+		KalmanAxis north = north_;
+		KalmanAxis up = up_;
+		east.predict(dt, FILTER_HORIZONTAL_ACCEL * FILTER_HORIZONTAL_ACCEL);
+		north.predict(dt, FILTER_HORIZONTAL_ACCEL * FILTER_HORIZONTAL_ACCEL);
+		up.predict(dt, FILTER_VERTICAL_ACCEL * FILTER_VERTICAL_ACCEL);
+		out.latitude = originLat_ + north.position / EARTH_RADIUS * 180.0 / M_PI;
+		out.longitude = originLon_ + east.position / (EARTH_RADIUS * cosOriginLat_) * 180.0 / M_PI;
+		out.altitude = hasAltitude_ ? up.position : NAN;
+		out.hAccuracy = std::sqrt(std::max(east.p00, north.p00));
+		out.vAccuracy = hasAltitude_ ? std::sqrt(up.p00) : NAN;
+		out.speed = std::hypot(east.velocity, north.velocity);
+		out.heading = std::fmod(std::atan2(east.velocity, north.velocity) * 180.0 / M_PI + 360.0, 360.0);
+		out.vVelocity = up.velocity;
+		return true;
+	}
+
+private:
+	bool initialised_ = false;
+	bool hasAltitude_ = false;
+	unsigned long long lastUpdate_ = 0;
+	double originLat_ = 0;
+	double originLon_ = 0;
+	double cosOriginLat_ = 1;
+	KalmanAxis east_;
+	KalmanAxis north_;
+	KalmanAxis up_;
+
+	static double variance(const double accuracy, const double fallback) {
+		const double sigma = std::isnan(accuracy) || accuracy <= 0 ? fallback : accuracy;
+		return sigma * sigma;
+	}
+
+	void setOrigin(const double latitude, const double longitude) {
+		originLat_ = latitude;
+		originLon_ = longitude;
+		cosOriginLat_ = std::cos(latitude * M_PI / 180.0);
+	}
+
+	[[nodiscard]] double toEast(const double longitude) const {
+		return (longitude - originLon_) * M_PI / 180.0 * EARTH_RADIUS * cosOriginLat_;
+	}
+
+	[[nodiscard]] double toNorth(const double latitude) const {
+		return (latitude - originLat_) * M_PI / 180.0 * EARTH_RADIUS;
+	}
+
+	void predictTo(const unsigned long long now) {
+		if (now <= lastUpdate_) {
+			return;
+		}
+		const double dt = (now - lastUpdate_) / 1000.0;
+		east_.predict(dt, FILTER_HORIZONTAL_ACCEL * FILTER_HORIZONTAL_ACCEL);
+		north_.predict(dt, FILTER_HORIZONTAL_ACCEL * FILTER_HORIZONTAL_ACCEL);
+		up_.predict(dt, FILTER_VERTICAL_ACCEL * FILTER_VERTICAL_ACCEL);
+		lastUpdate_ = now;
+	}
+
+	void reanchor() {
+		const double latitude = originLat_ + north_.position / EARTH_RADIUS * 180.0 / M_PI;
+		const double longitude = originLon_ + east_.position / (EARTH_RADIUS * cosOriginLat_) * 180.0 / M_PI;
+		setOrigin(latitude, longitude);
+		east_.position = 0;
+		north_.position = 0;
+	}
+};
+
+#endif //POSITIONFILTER_H
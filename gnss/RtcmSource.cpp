@@ -0,0 +1,224 @@
+#include "RtcmSource.h"
+
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/ip/address.hpp>
+
+#include "../event/EventDispatcher.h"
+#include "../logging/Logger.h"
+#include "../utils/RTCMUtils.h"
+#include "../utils/TimeUtils.h"
+
+RtcmSource::RtcmSource(boost::asio::io_context& ioCtx, const std::string& source): udpSocket_(ioCtx), tcpSocket_(ioCtx),
+    resolver_(ioCtx), timer_(ioCtx) {
+    std::string_view rest = source;
+    const bool udp = rest.starts_with("udp://");
+    const bool tcp = rest.starts_with("tcp://");
+    if (udp || tcp) {
+        rest.remove_prefix(6);
+        const size_t colon = rest.rfind(':');
+        if (colon == std::string_view::npos) {
+            Logger::instance().error("RtcmSource", "No port in RTCM source " + source);
+            return;
+        }
+        host_ = rest.substr(0, colon);
+        port_ = rest.substr(colon + 1);
+        if (udp) {
+            startUdp();
+        } else {
+            connectTcp();
+        }
+        return;
+    }
+    if (rest.starts_with("file://")) {
+        rest.remove_prefix(7);
+    }
+    if (loadFile(std::string(rest))) {
+        playFileEpoch();
+    }
+}
+
+void RtcmSource::startUdp() {
+    unsigned short port = 0;
+    if (std::from_chars(port_.data(), port_.data() + port_.size(), port).ec != std::errc{}) {
+        Logger::instance().error("RtcmSource", "Invalid RTCM UDP port " + port_);
+        return;
+    }
+    boost::system::error_code ec;
+    const auto address = host_.empty() ? boost::asio::ip::address_v4::any() : boost::asio::ip::make_address(host_, ec);
+    if (!ec) {
+        const boost::asio::ip::udp::endpoint endpoint(address, port);
+        udpSocket_.open(endpoint.protocol(), ec);
+        if (!ec) {
+            udpSocket_.bind(endpoint, ec);
+        }
+    }
+    if (ec) {
+        Logger::instance().error("RtcmSource", "Failed to listen for RTCM on " + host_ + ":" + port_ + " - " +
+                                 ec.message());
+        return;
+    }
+    Logger::instance().info("RtcmSource", "Listening for RTCM on UDP " + host_ + ":" + port_);
+    receiveUdp();
+}
+
+void RtcmSource::receiveUdp() {
+    udpSocket_.async_receive(boost::asio::buffer(dataBuf_.data() + pending_, dataBuf_.size() - pending_),
+        [this](const boost::system::error_code& ec, const std::size_t length) {
+        if (ec == boost::asio::error::operation_aborted) {
+            return;
+        }
+        if (ec) {
+            Logger::instance().warn("RtcmSource", "Error receiving RTCM datagram - " + ec.message());
+        } else {
+            pending_ += length;
+            processPending();
+        }
+        receiveUdp();
+    });
+}
+
+void RtcmSource::connectTcp() {
+    resolver_.async_resolve(host_, port_, [this](const boost::system::error_code& ec,
+                                                 const boost::asio::ip::tcp::resolver::results_type& results) {
+        if (ec) {
+            Logger::instance().warn("RtcmSource", "Failed to resolve RTCM caster " + host_ + " - " + ec.message());
+            scheduleReconnect();
+            return;
+        }
+        boost::asio::async_connect(tcpSocket_, results, [this](const boost::system::error_code& connectEc,
+                                                               const boost::asio::ip::tcp::endpoint&) {
+            if (connectEc) {
+                Logger::instance().warn("RtcmSource", "Failed to connect to RTCM caster " + host_ + ":" + port_ +
+                                        " - " + connectEc.message());
+                scheduleReconnect();
+                return;
+            }
+            Logger::instance().info("RtcmSource", "Connected to RTCM caster " + host_ + ":" + port_);
+            pending_ = 0;
+            readTcp();
+        });
+    });
+}
+
+void RtcmSource::readTcp() {
+    tcpSocket_.async_read_some(boost::asio::buffer(dataBuf_.data() + pending_, dataBuf_.size() - pending_),
+        [this](const boost::system::error_code& ec, const std::size_t length) {
+        if (ec) {
+            Logger::instance().warn("RtcmSource", "RTCM stream from " + host_ + " lost - " + ec.message());
+            boost::system::error_code ignored;
+            tcpSocket_.close(ignored);
+            scheduleReconnect();
+            return;
+        }
+        pending_ += length;
+        processPending();
+        readTcp();
+    });
+}
+
+void RtcmSource::scheduleReconnect() {
+    timer_.expires_after(boost::asio::chrono::milliseconds(RTCM_RECONNECT_MS));
+    timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (!ec) {
+            connectTcp();
+        }
+    });
+}
+
+bool RtcmSource::loadFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open()) {
+        Logger::instance().error("RtcmSource", "Failed to open RTCM file " + path);
+        return false;
+    }
+    file_.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    if (file_.empty()) {
+        Logger::instance().warn("RtcmSource", "RTCM file " + path + " is empty");
+        return false;
+    }
+    Logger::instance().info("RtcmSource", "Playing RTCM corrections from " + path);
+    return true;
+}
+
+void RtcmSource::playFileEpoch() {
+    //An epoch carries each message type once, so the first repeat starts the next one
+    std::set<uint16_t> sent;
+    while (true) {
+        if (fileOffset_ >= file_.size()) {
+            fileOffset_ = 0;
+            if (sent.empty()) {
+                Logger::instance().error("RtcmSource", "No RTCM messages in file, stopping playback");
+                return;
+            }
+        }
+        const std::string_view data(reinterpret_cast<const char*>(file_.data()) + fileOffset_,
+                                    file_.size() - fileOffset_);
+        RtcmFrame frame;
+        size_t consumed = 0;
+        const RtcmParseResult res = parseRtcmFrame(data, frame, consumed);
+        if (res != RtcmParseResult::OK) {
+            //A torn message at the end of the recording is skipped along with any other garbage
+            fileOffset_++;
+            continue;
+        }
+        if (!sent.insert(frame.messageType).second) {
+            break;
+        }
+        publish(frame.messageType, frame.frame, frame.length);
+        fileOffset_ += consumed;
+    }
+    timer_.expires_after(boost::asio::chrono::milliseconds(RTCM_FILE_EPOCH_MS));
+    timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (!ec) {
+            playFileEpoch();
+        }
+    });
+}
+
+void RtcmSource::processPending() {
+    //Same approach as GnssReader: frame in place, keep a partial message for the next read, skip bytes until the
+    //next preamble when a frame does not check out
+    size_t pos = 0;
+    while (pos < pending_) {
+        const std::string_view data(reinterpret_cast<const char*>(dataBuf_.data()) + pos, pending_ - pos);
+        RtcmFrame frame;
+        size_t consumed = 0;
+        const RtcmParseResult res = parseRtcmFrame(data, frame, consumed);
+        if (res == RtcmParseResult::INCOMPLETE) {
+            break;
+        }
+        if (res == RtcmParseResult::OK) {
+            publish(frame.messageType, frame.frame, frame.length);
+            pos += consumed;
+            continue;
+        }
+        if (res == RtcmParseResult::INVALID_CHECKSUM && crcErrors_++ % 100 == 0) {
+            Logger::instance().warn("RtcmSource", "RTCM message failed CRC-24Q, " + std::to_string(crcErrors_) +
+                                    " so far");
+        }
+        pos++;
+    }
+    if (pos > 0) {
+        std::memmove(dataBuf_.data(), dataBuf_.data() + pos, pending_ - pos);
+        pending_ -= pos;
+    }
+    //The buffer holds more than any one message, so a full buffer can only be garbage
+    if (pending_ == dataBuf_.size()) {
+        pending_ = 0;
+    }
+}
+
+void RtcmSource::publish(const uint16_t messageType, const uint8_t* frame, const size_t length) {
+    auto* ev = acquireEvent<RTKCorrectionEvent>();
+    ev->messageType = messageType;
+    ev->received = systemTimeMillis();
+    ev->frame.assign(frame, frame + length);
+    if (messages_++ == 0) {
+        Logger::instance().info("RtcmSource", "First RTCM message received, type " + std::to_string(messageType));
+    }
+    EventDispatcher::instance().dispatchAsync(ev);
+}
@@ -0,0 +1,57 @@
+#ifndef RTCMSOURCE_H
+#define RTCMSOURCE_H
+
+#include <array>
+#include <set>
+#include <string>
+#include <vector>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+//A TCP caster that drops us is retried after this long
+static constexpr unsigned int RTCM_RECONNECT_MS = 5000;
+//A file stand-in sends one epoch of corrections per interval, as a base station would
+static constexpr unsigned int RTCM_FILE_EPOCH_MS = 1000;
+
+///
+/// Receives RTCM3 corrections and publishes each CRC-24Q checked message as an RTKCorrectionEvent for GnssReader to
+/// pass on to the receiver. rtcmSource selects where they come from:
+///   udp://[address]:port   datagrams sent to us by a base station or radio bridge
+///   tcp://host:port        a raw RTCM3 stream, reconnected whenever it drops
+///   file://path or a path  a recorded stream, played back an epoch a second and looped, standing in for a base
+/// Bytes are framed as a stream whatever the transport, so messages split across datagrams or reads are reassembled.
+///
+class RtcmSource {
+public:
+    RtcmSource(boost::asio::io_context& ioCtx, const std::string& source);
+
+private:
+    boost::asio::ip::udp::socket udpSocket_;
+    boost::asio::ip::tcp::socket tcpSocket_;
+    boost::asio::ip::tcp::resolver resolver_;
+    boost::asio::steady_timer timer_;
+    std::string host_;
+    std::string port_;
+
+    std::array<uint8_t, 4096> dataBuf_ = {};
+    size_t pending_ = 0;
+    std::vector<uint8_t> file_;
+    size_t fileOffset_ = 0;
+
+    unsigned long long messages_ = 0;
+    unsigned long long crcErrors_ = 0;
+
+    void startUdp();
+    void receiveUdp();
+    void connectTcp();
+    void readTcp();
+    void scheduleReconnect();
+    bool loadFile(const std::string& path);
+    void playFileEpoch();
+    void processPending();
+    void publish(uint16_t messageType, const uint8_t* frame, size_t length);
+};
+
+#endif //RTCMSOURCE_H
@@ -0,0 +1,255 @@
+#include "InfluxSink.h"
+
+#include <algorithm>
+#include <boost/asio/connect.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/write.hpp>
+
+#include "LineProtocol.h"
+#include "../config/ConfigProvider.h"
+#include "../logging/Logger.h"
+#include "../utils/GzipUtils.h"
+
+namespace http = boost::beast::http;
+
+InfluxSink::InfluxSink(boost::asio::io_context& ioCtx, TelemetrySpool& spool, const std::string& address):
+    spool_(spool), cursor_(spool.openCursor("influx")), resolver_(ioCtx), stream_(ioCtx), flushTimer_(ioCtx),
+    retryTimer_(ioCtx) {
+    const ConfigProvider& config = ConfigProvider::instance();
+    assetName_ = config.assetName();
+    batchSize_ = config.influxBatchSize() > 0 ? config.influxBatchSize() : 65536;
+    flushIntervalMs_ = config.influxFlushInterval() > 0 ? config.influxFlushInterval() : 1000;
+
+    //http://host[:port][/path], TLS is left to a local proxy
+    std::string_view rest = address;
+    if (rest.starts_with("https://")) {
+        Logger::instance().error("InfluxSink", "HTTPS is not supported, point influxAddress at a plain HTTP endpoint");
+        rest.remove_prefix(8);
+    } else if (rest.starts_with("http://")) {
+        rest.remove_prefix(7);
+    }
+    const size_t pathStart = rest.find('/');
+    const std::string_view hostPort = rest.substr(0, pathStart);
+    const std::string_view basePath = pathStart == std::string_view::npos ? std::string_view{} : rest.substr(pathStart);
+    if (const size_t colon = hostPort.find(':'); colon != std::string_view::npos) {
+        host_ = hostPort.substr(0, colon);
+        port_ = hostPort.substr(colon + 1);
+    } else {
+        host_ = hostPort;
+    }
+    target_ = std::string(basePath.ends_with('/') ? basePath.substr(0, basePath.size() - 1) : basePath) +
+              "/api/v2/write?bucket=" + config.influxBucket() + "&precision=ms";
+    if (!config.influxOrg().empty()) {
+        target_ += "&org=" + config.influxOrg();
+    }
+    if (!config.influxToken().empty()) {
+        authorization_ = "Token " + config.influxToken();
+    }
+    batch_.reserve(batchSize_ + batchSize_ / 4);
+
+    Logger::instance().info("InfluxSink", "Writing to " + host_ + ":" + port_ + target_);
+    scheduleFlush();
+    boost::asio::post(ioCtx, [this]() { sendNext(); });
+}
+
+void InfluxSink::appendProperty(const SpoolRecord& record) {
+    LineBuilder line(batch_);
+    //Every value of a message shares its instance, so this is normally one line per record
+    std::string_view instance;
+    bool open = false;
+    std::string_view deviceUid;
+    decodeSpoolProperty(record.payload, deviceUid, [&](const SpoolPropertyValue& value) {
+        if (value.kind != SPOOL_VALUE_NUMBER) {
+            //Not available or not numeric
+            return;
+        }
+        if (!open || instance != value.instance) {
+            if (open) {
+                line.end(record.timestamp);
+            }
+            open = true;
+            instance = value.instance;
+            line.begin("n2k");
+            line.tag("asset", assetName_);
+            line.tag("device", deviceUid);
+            line.tag("instance", value.instance);
+        }
+        line.field(value.propertyUid, value.number);
+    });
+    if (open) {
+        line.end(record.timestamp);
+    }
+}
+
+void InfluxSink::appendPosition(const SpoolRecord& record) {
+    PositionEvent ev;
+    if (!decodeSpoolPosition(record.payload, ev) || !ev.fixValid) {
+        return;
+    }
+    LineBuilder line(batch_);
+    line.begin("position");
+    line.tag("asset", assetName_);
+    line.tag("source", ev.source == N2K ? "N2K" : "USB");
+    line.field("lat", ev.latitude);
+    line.field("lon", ev.longitude);
+    line.field("alt", ev.altitude);
+    line.field("hacc", ev.hAccuracy);
+    line.field("vacc", ev.vAccuracy);
+    line.field("sog", ev.speed);
+    line.field("cog", ev.heading);
+    line.field("vvel", ev.vVelocity);
+    line.field("corr_age", ev.correctionAge);
+    line.field("hdop", ev.hdop);
+    line.intField("fix", ev.fixQuality);
+    line.end(record.timestamp);
+}
+
+void InfluxSink::scheduleFlush() {
+    flushTimer_.expires_after(boost::asio::chrono::milliseconds(flushIntervalMs_));
+    flushTimer_.async_wait([this](const boost::system::error_code& ec) {
+        if (!ec) {
+            sendNext();
+            scheduleFlush();
+        }
+    });
+}
+
+void InfluxSink::sendNext() {
+    if (sending_ || linkDown_) {
+        return;
+    }
+    batch_.clear();
+    const size_t records = spool_.read(cursor_, [this](const SpoolRecord& record) {
+        if (record.type == SPOOL_PROPERTY) {
+            appendProperty(record);
+        } else if (record.type == SPOOL_POSITION) {
+            appendPosition(record);
+        }
+        return batch_.size() < batchSize_;
+    });
+    if (batch_.empty()) {
+        if (records > 0) {
+            //Nothing in there InfluxDB wants, e.g. only lost fixes
+            spool_.commit(cursor_);
+        }
+        return;
+    }
+    if (!gzipCompress(batch_, inFlight_)) {
+        Logger::instance().error("InfluxSink", "Failed to compress batch, dropping " + std::to_string(records) +
+                                 " records");
+        spool_.commit(cursor_);
+        return;
+    }
+    rawBytes_ += batch_.size();
+    LOG_DEBUG("InfluxSink", "Batch of " + std::to_string(records) + " records, " + std::to_string(batch_.size()) +
+              " bytes compressed to " + std::to_string(inFlight_.size()));
+    sending_ = true;
+    if (stream_.socket().is_open()) {
+        write();
+    } else {
+        connect();
+    }
+}
+
+void InfluxSink::connect() {
+    resolver_.async_resolve(host_, port_, [this](const boost::system::error_code& ec,
+                                                 const boost::asio::ip::tcp::resolver::results_type& results) {
+        if (ec) {
+            Logger::instance().warn("InfluxSink", "Failed to resolve " + host_ + " - " + ec.message());
+            writeComplete(false, true);
+            return;
+        }
+        stream_.expires_after(boost::asio::chrono::milliseconds(INFLUX_REQUEST_TIMEOUT_MS));
+        stream_.async_connect(results, [this](const boost::system::error_code& connectEc,
+                                              const boost::asio::ip::tcp::endpoint&) {
+            if (connectEc) {
+                Logger::instance().warn("InfluxSink", "Failed to connect to " + host_ + " - " + connectEc.message());
+                writeComplete(false, true);
+                return;
+            }
+            write();
+        });
+    });
+}
+
+void InfluxSink::write() {
+    request_ = {};
+    request_.method(http::verb::post);
+    request_.target(target_);
+    request_.version(11);
+    request_.keep_alive(true);
+    request_.set(http::field::host, port_ == "80" ? host_ : host_ + ":" + port_);
+    request_.set(http::field::content_type, "text/plain; charset=utf-8");
+    request_.set(http::field::content_encoding, "gzip");
+    if (!authorization_.empty()) {
+        request_.set(http::field::authorization, authorization_);
+    }
+    request_.body() = inFlight_;
+    request_.prepare_payload();
+    stream_.expires_after(boost::asio::chrono::milliseconds(INFLUX_REQUEST_TIMEOUT_MS));
+    http::async_write(stream_, request_, [this](const boost::system::error_code& ec, std::size_t) {
+        if (ec) {
+            Logger::instance().warn("InfluxSink", "Failed to send batch - " + ec.message());
+            writeComplete(false, true);
+            return;
+        }
+        response_ = {};
+        http::async_read(stream_, buffer_, response_, [this](const boost::system::error_code& readEc, std::size_t) {
+            if (readEc) {
+                Logger::instance().warn("InfluxSink", "No response to batch - " + readEc.message());
+                writeComplete(false, true);
+                return;
+            }
+            if (!response_.keep_alive()) {
+                boost::system::error_code ignored;
+                stream_.socket().close(ignored);
+            }
+            const unsigned int status = response_.result_int();
+            if (status >= 200 && status < 300) {
+                writeComplete(true, false);
+                return;
+            }
+            Logger::instance().warn("InfluxSink", "Batch rejected with HTTP " + std::to_string(status) + " - " +
+                                    response_.body().substr(0, 200));
+            //A malformed batch will never be accepted, anything else is worth another try
+            writeComplete(false, status == 429 || status >= 500);
+        });
+    });
+}
+
+void InfluxSink::writeComplete(const bool delivered, const bool retry) {
+    sending_ = false;
+    if (delivered) {
+        sentBytes_ += inFlight_.size();
+    }
+    inFlight_.clear();
+    if (delivered || !retry) {
+        if (delivered) {
+            if (retryMs_ != INFLUX_RETRY_MIN_MS) {
+                Logger::instance().info("InfluxSink", "Link to InfluxDB restored, replaying spool");
+            }
+            retryMs_ = INFLUX_RETRY_MIN_MS;
+        }
+        spool_.commit(cursor_);
+        //Keep going while there is a backlog, sendNext returns straight away once the spool is drained
+        sendNext();
+        return;
+    }
+    boost::system::error_code ignored;
+    stream_.socket().close(ignored);
+    //Everything since the last commit is read again once the link is back
+    spool_.rewind(cursor_);
+    if (retryMs_ == INFLUX_RETRY_MIN_MS) {
+        Logger::instance().warn("InfluxSink", "Link to InfluxDB lost, holding records in the spool");
+    }
+    linkDown_ = true;
+    retryTimer_.expires_after(boost::asio::chrono::milliseconds(retryMs_));
+    retryTimer_.async_wait([this](const boost::system::error_code& ec) {
+        if (!ec) {
+            linkDown_ = false;
+            sendNext();
+        }
+    });
+    retryMs_ = std::min(retryMs_ * 2, INFLUX_RETRY_MAX_MS);
+}
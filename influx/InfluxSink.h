@@ -0,0 +1,67 @@
+#ifndef INFLUXSINK_H
+#define INFLUXSINK_H
+
+#include <string>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/core/tcp_stream.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/beast/http/string_body.hpp>
+
+#include "../spool/TelemetrySpool.h"
+
+static constexpr unsigned int INFLUX_REQUEST_TIMEOUT_MS = 10000;
+//After a failed write we wait this long before trying again, doubling up to the maximum while the link stays down
+static constexpr unsigned int INFLUX_RETRY_MIN_MS = 2000;
+static constexpr unsigned int INFLUX_RETRY_MAX_MS = 60000;
+
+///
+/// Ships decoded bus values and positions to InfluxDB as line protocol. Records are read from the telemetry spool
+/// through the "influx" cursor every influxFlushInterval ms, formatted into a batch of up to influxBatchSize bytes,
+/// gzipped and posted over one kept-alive HTTP connection on the io context. The cursor is only committed once
+/// InfluxDB has accepted the batch, so an outage on the cellular link or a restart replays from the spool, with each
+/// point keeping the time it was recorded. While there is a backlog batches are sent back to back.
+///
+class InfluxSink {
+public:
+    InfluxSink(boost::asio::io_context& ioCtx, TelemetrySpool& spool, const std::string& address);
+
+private:
+    TelemetrySpool& spool_;
+    SpoolCursor& cursor_;
+    boost::asio::ip::tcp::resolver resolver_;
+    boost::beast::tcp_stream stream_;
+    boost::asio::steady_timer flushTimer_;
+    boost::asio::steady_timer retryTimer_;
+    std::string host_;
+    std::string port_ = "80";
+    std::string target_;
+    std::string authorization_;
+    std::string assetName_;
+    size_t batchSize_;
+    unsigned int flushIntervalMs_;
+
+    //Everything below is only touched on the io context
+    std::string batch_;
+    std::string inFlight_;
+    bool sending_ = false;
+    bool linkDown_ = false;
+    unsigned int retryMs_ = INFLUX_RETRY_MIN_MS;
+    boost::beast::http::request<boost::beast::http::string_body> request_;
+    boost::beast::http::response<boost::beast::http::string_body> response_;
+    boost::beast::flat_buffer buffer_;
+    unsigned long long rawBytes_ = 0;
+    unsigned long long sentBytes_ = 0;
+
+    void appendProperty(const SpoolRecord& record);
+    void appendPosition(const SpoolRecord& record);
+    void scheduleFlush();
+    void sendNext();
+    void connect();
+    void write();
+    void writeComplete(bool delivered, bool retry);
+};
+
+#endif //INFLUXSINK_H
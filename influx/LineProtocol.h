@@ -0,0 +1,93 @@
+#ifndef LINEPROTOCOL_H
+#define LINEPROTOCOL_H
+
+#include <charconv>
+#include <cmath>
+#include <string>
+#include <string_view>
+
+///
+/// Builds InfluxDB line protocol straight into a batch buffer, e.g.
+///   position,asset=CCM,source=USB lat=51.5,lon=-1.33,fix=3i 1697040000123
+/// Numbers are written with to_chars, so every value takes the fewest characters that round trip. A line is only
+/// valid once it has at least one field; end() returns false and rolls the line back when it has none.
+///
+class LineBuilder {
+public:
+    explicit LineBuilder(std::string& out): out_(out) {}
+
+    void begin(const std::string_view measurement) {
+        lineStart_ = out_.size();
+        fieldCount_ = 0;
+        appendEscaped(measurement, false);
+    }
+
+    void tag(const std::string_view key, const std::string_view value) {
+        if (value.empty()) {
+            return;
+        }
+        out_.push_back(',');
+        appendEscaped(key, true);
+        out_.push_back('=');
+        appendEscaped(value, true);
+    }
+
+    /// NaN and infinite values are left out of the line
+    void field(const std::string_view key, const double value) {
+        if (!std::isfinite(value)) {
+            return;
+        }
+        fieldSeparator();
+        appendEscaped(key, true);
+        out_.push_back('=');
+        appendNumber(value);
+    }
+
+    void intField(const std::string_view key, const long long value) {
+        fieldSeparator();
+        appendEscaped(key, true);
+        out_.push_back('=');
+        appendNumber(value);
+        out_.push_back('i');
+    }
+
+    /// Finishes the line with a millisecond timestamp
+    bool end(const unsigned long long timestampMs) {
+        if (fieldCount_ == 0) {
+            out_.resize(lineStart_);
+            return false;
+        }
+        out_.push_back(' ');
+        appendNumber(timestampMs);
+        out_.push_back('\n');
+        return true;
+    }
+
+private:
+    std::string& out_;
+    size_t lineStart_ = 0;
+    size_t fieldCount_ = 0;
+
+    void fieldSeparator() {
+        out_.push_back(fieldCount_++ == 0 ? ' ' : ',');
+    }
+
+    /// Measurements, tag keys, tag values and field keys escape commas and spaces; all but measurements escape '='
+    void appendEscaped(const std::string_view text, const bool escapeEquals) {
+        for (const char c : text) {
+            if (c == ',' || c == ' ' || (c == '=' && escapeEquals)) {
+                out_.push_back('\\');
+            }
+            out_.push_back(c);
+        }
+    }
+
+    template<typename T>
+    void appendNumber(const T value) {
+        char buf[32];
+        const auto res = std::to_chars(buf, buf + sizeof(buf), value);
+        out_.append(buf, res.ptr);
+    }
+};
+
+#endif //LINEPROTOCOL_H
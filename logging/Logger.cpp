@@ -1,12 +1,8 @@
 #include "Logger.h"
 
-#include <chrono>
+#include <cstdio>
 #include <ctime>
-#include <iomanip>
 #include <iostream>
-#include <sstream>
-
-//TODO: Selective log levels
 
 namespace ansi {
     constexpr auto reset   = "\033[0m";
@@ -18,13 +14,20 @@ namespace ansi {
     constexpr auto cyan    = "\033[36m";
 }
 
-LogLevel Logger::checkLevel(const std::string& className) const {
-    if (levels.contains(className)) {
-        return levels.at(className);
+LogLevel Logger::checkLevel(const std::string_view className) const {
+    if (const auto it = levels.find(className); it != levels.end()) {
+        return it->second;
     }
     return baseLevel;
 }
 
+bool Logger::enabled(const LogLevel level, const std::string_view className) const {
+    if (level < minLevel) {
+        return false;
+    }
+    return checkLevel(className) <= level;
+}
+
 const char* Logger::levelToString(const LogLevel level) {
     switch (level) {
         case TRACE:    return "TRACE";
@@ -49,78 +52,126 @@ const char* Logger::levelColor(const LogLevel level) {
     }
 }
 
-std::string Logger::iso8601Now() {
-    using namespace std::chrono;
-    const auto now = system_clock::now();
-    auto time = system_clock::to_time_t(now);
-    const auto ms = duration_cast<milliseconds>(now.time_since_epoch()) % 1000;
-
-    std::tm tm{};
-#if defined(_WIN32)
-    gmtime_s(&tm, &time);
-#else
-    gmtime_r(&time, &tm);
-#endif
-
-    std::ostringstream oss;
-    oss << std::put_time(&tm, "%Y-%m-%dT%H:%M:%S")
-        << '.' << std::setw(3) << std::setfill('0') << ms.count()
-        << 'Z';
-    return oss.str();
-}
-
 Logger &Logger::instance() {
     static Logger l;
     return l;
 }
 
-void Logger::trace(const std::string& className, const std::string& msg) const {
-    if (checkLevel(className) <= TRACE) {
-        writeLog(TRACE, className, msg);
+void Logger::log(const LogLevel level, const std::string_view className, std::string msg) {
+    if (!queue_.push(LogRecord{level, std::chrono::system_clock::now(), std::string(className), std::move(msg)})) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (writerSleeping_.exchange(false, std::memory_order_acq_rel)) {
+        wake_.release();
+    }
+}
+
+void Logger::trace(const std::string& className, std::string msg) {
+    if (enabled(TRACE, className)) {
+        log(TRACE, className, std::move(msg));
     }
 }
 
-void Logger::debug(const std::string& className, const std::string& msg) const {
-    if (checkLevel(className) <= DEBUG) {
-        writeLog(DEBUG, className, msg);
+void Logger::debug(const std::string& className, std::string msg) {
+    if (enabled(DEBUG, className)) {
+        log(DEBUG, className, std::move(msg));
     }
 }
 
-void Logger::info(const std::string& className, const std::string& msg) const {
-    if (checkLevel(className) <= INFO) {
-        writeLog(INFO, className, msg);
+void Logger::info(const std::string& className, std::string msg) {
+    if (enabled(INFO, className)) {
+        log(INFO, className, std::move(msg));
     }
 }
 
-void Logger::warn(const std::string& className, const std::string& msg) const {
-    if (checkLevel(className) <= WARN) {
-        writeLog(WARN, className, msg);
+void Logger::warn(const std::string& className, std::string msg) {
+    if (enabled(WARN, className)) {
+        log(WARN, className, std::move(msg));
     }
 }
 
-void Logger::error(const std::string& className, const std::string& msg) const {
-    if (checkLevel(className) <= ERROR) {
-        writeLog(ERROR, className, msg);
+void Logger::error(const std::string& className, std::string msg) {
+    if (enabled(ERROR, className)) {
+        log(ERROR, className, std::move(msg));
     }
 }
 
-void Logger::critical(const std::string& className, const std::string& msg) const {
-    if (checkLevel(className) <= CRITICAL) {
-        writeLog(CRITICAL, className, msg);
+void Logger::critical(const std::string& className, std::string msg) {
+    if (enabled(CRITICAL, className)) {
+        log(CRITICAL, className, std::move(msg));
     }
 }
 
 Logger::Logger() {
     levels["GnssReader"] = TRACE;
+    minLevel = baseLevel;
+    for (const auto& [className, level] : levels) {
+        minLevel = std::min(minLevel, level);
+    }
+    writer_ = std::thread(&Logger::writerThread, this);
+}
+
+Logger::~Logger() {
+    quitting_ = true;
+    wake_.release();
+    if (writer_.joinable()) {
+        writer_.join();
+    }
 }
 
-void Logger::writeLog(const LogLevel level, const std::string& className, const std::string& msg) {
-    std::stringstream oss;
-    oss << ansi::green << iso8601Now() << ansi::reset << " ";
-    oss << levelColor(level)
-        << std::left << std::setw(8) << levelToString(level)
-        << ansi::reset << " ";
-    oss << ansi::yellow << className << ansi::reset << ": ";
-    oss << msg;
-    std::cout << oss.str() << std::endl;
+void Logger::formatRecord(const LogRecord& record, std::string& out) {
+    using namespace std::chrono;
+    const auto sinceEpoch = duration_cast<milliseconds>(record.time.time_since_epoch());
+    if (const auto second = duration_cast<seconds>(sinceEpoch).count(); second != cachedSecond_) {
+        const std::time_t time = second;
+        std::tm tm{};
+        gmtime_r(&time, &tm);
+        char buf[32];
+        std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+        cachedTimestamp_ = buf;
+        cachedSecond_ = second;
+    }
+    char ms[8];
+    std::snprintf(ms, sizeof(ms), ".%03dZ", static_cast<int>(sinceEpoch.count() % 1000));
+    char level[16];
+    std::snprintf(level, sizeof(level), "%-8s", levelToString(record.level));
+
+    out.append(ansi::green).append(cachedTimestamp_).append(ms).append(ansi::reset).append(" ");
+    out.append(levelColor(record.level)).append(level).append(ansi::reset).append(" ");
+    out.append(ansi::yellow).append(record.className).append(ansi::reset).append(": ");
+    out.append(record.msg).append("\n");
+}
+
+void Logger::writerThread() {
+    std::string batch;
+    LogRecord record;
+    while (true) {
+        while (queue_.pop(record)) {
+            formatRecord(record, batch);
+        }
+        if (const auto dropped = dropped_.exchange(0, std::memory_order_relaxed); dropped != 0) {
+            formatRecord({WARN, std::chrono::system_clock::now(), "Logger", std::to_string(dropped) + " log messages dropped"}, batch);
+        }
+        if (!batch.empty()) {
+            std::cout.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+            std::cout.flush();
+            batch.clear();
+            continue;
+        }
+        if (quitting_) {
+            return;
+        }
+        //Announce we are going to sleep, then look again so a record pushed in between is not missed
+        writerSleeping_.store(true, std::memory_order_release);
+        if (queue_.pop(record)) {
+            //A producer that already took the flag has posted a wakeup we no longer need
+            if (!writerSleeping_.exchange(false, std::memory_order_acq_rel)) {
+                wake_.try_acquire();
+            }
+            formatRecord(record, batch);
+            continue;
+        }
+        wake_.try_acquire_for(std::chrono::milliseconds(250));
+    }
 }
@@ -1,38 +1,89 @@
 #ifndef LOGGER_H
 #define LOGGER_H
+#include <atomic>
+#include <chrono>
 #include <map>
+#include <semaphore>
 #include <string>
+#include <string_view>
+#include <thread>
+
+#include "../event/MpmcQueue.h"
 
 enum LogLevel {
     TRACE, DEBUG, INFO, WARN, ERROR, CRITICAL
 };
 
+///
+/// Level checked logging macros. The message expression is only evaluated when the level is enabled for the class,
+/// so string building on a disabled trace/debug line costs nothing. Prefer these on hot paths.
+///
+#define LOG_AT(level, className, msg) \
+    do { if (Logger::instance().enabled(level, className)) { Logger::instance().log(level, className, msg); } } while (0)
+#define LOG_TRACE(className, msg) LOG_AT(TRACE, className, msg)
+#define LOG_DEBUG(className, msg) LOG_AT(DEBUG, className, msg)
+#define LOG_INFO(className, msg) LOG_AT(INFO, className, msg)
+#define LOG_WARN(className, msg) LOG_AT(WARN, className, msg)
+#define LOG_ERROR(className, msg) LOG_AT(ERROR, className, msg)
+#define LOG_CRITICAL(className, msg) LOG_AT(CRITICAL, className, msg)
+
+static constexpr size_t LOG_QUEUE_SIZE = 4096;
+
+///
+/// Asynchronous logger. Callers only check the level and push a record onto a lock-free queue; a single writer thread
+/// formats records in batches and flushes once per batch. If the queue fills up records are dropped rather than
+/// blocking the caller, and the writer reports how many were lost.
+///
 class Logger {
 public:
     static Logger& instance();
+    ~Logger();
 
-    void trace(const std::string& className, const std::string& msg) const;
-    void debug(const std::string& className, const std::string& msg) const;
-    void info(const std::string& className, const std::string& msg) const;
-    void warn(const std::string& className, const std::string& msg) const;
-    void error(const std::string& className, const std::string& msg) const;
-    void critical(const std::string& className, const std::string& msg) const;
+    [[nodiscard]] bool enabled(LogLevel level, std::string_view className) const;
+    void log(LogLevel level, std::string_view className, std::string msg);
+
+    void trace(const std::string& className, std::string msg);
+    void debug(const std::string& className, std::string msg);
+    void info(const std::string& className, std::string msg);
+    void warn(const std::string& className, std::string msg);
+    void error(const std::string& className, std::string msg);
+    void critical(const std::string& className, std::string msg);
 
 private:
+    struct LogRecord {
+        LogLevel level = INFO;
+        std::chrono::system_clock::time_point time;
+        std::string className;
+        std::string msg;
+    };
+
     Logger();
     Logger(const Logger&) = delete;
     Logger& operator=(const Logger&) = delete;
 
     LogLevel baseLevel = INFO;
-    std::map<std::string, LogLevel> levels;
+    //Lowest level enabled for any class, lets most disabled calls return without a map lookup
+    LogLevel minLevel = INFO;
+    std::map<std::string, LogLevel, std::less<>> levels;
+
+    MpmcQueue<LogRecord, LOG_QUEUE_SIZE> queue_;
+    std::atomic<unsigned long long> dropped_ = 0;
+    std::atomic<bool> writerSleeping_ = false;
+    std::atomic<bool> quitting_ = false;
+    //Counting, a wakeup can be posted while the writer is already awake and a binary semaphore may not exceed one
+    std::counting_semaphore<> wake_{0};
+    std::thread writer_;
 
-    [[nodiscard]] LogLevel checkLevel(const std::string& className) const;
+    [[nodiscard]] LogLevel checkLevel(std::string_view className) const;
 
     static const char *levelToString(LogLevel level);
     static const char *levelColor(LogLevel level);
-    static std::string iso8601Now();
+    void writerThread();
+    void formatRecord(const LogRecord& record, std::string& out);
 
-    static void writeLog(LogLevel level, const std::string& className, const std::string& msg);
+    //Timestamp text for the current second, rebuilt by the writer only when the second changes
+    std::chrono::system_clock::time_point::rep cachedSecond_ = -1;
+    std::string cachedTimestamp_;
 };
 
 #endif //LOGGER_H
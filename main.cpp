@@ -1,14 +1,20 @@
 #include <iostream>
+#include <memory>
 #include <thread>
 #include <boost/asio/io_context.hpp>
 
 #include "canbus/AsioCanSocket.h"
+#include "canbus/CanReplaySource.h"
 #include "canbus/N2KPropertyProvider.h"
 #include "config/ConfigProvider.h"
 #include "event/EventDispatcher.h"
 #include "gnss/GnssReader.h"
 #include "gnss/LocationProvider.h"
+#include "gnss/RtcmSource.h"
+#include "influx/InfluxSink.h"
 #include "logging/Logger.h"
+#include "mdss/MdssSender.h"
+#include "spool/TelemetrySpool.h"
 
 int main() {
     std::cout << "Riedel Chase Telemetry Service\n";
@@ -30,8 +36,27 @@ int main() {
         ioCtx.run();
     });
     LocationProvider locationProvider(ioCtx);
+    //Nothing is spooled without a sink to read it back, the spool would only fill up and start discarding
+    std::unique_ptr<TelemetrySpool> telemetrySpool;
+    std::unique_ptr<InfluxSink> influxSink;
+    if (const std::string& influxAddress = ConfigProvider::instance().influxAddress(); !influxAddress.empty()) {
+        telemetrySpool = std::make_unique<TelemetrySpool>(ioCtx, ConfigProvider::instance().telemetrySpoolDir());
+        influxSink = std::make_unique<InfluxSink>(ioCtx, *telemetrySpool, influxAddress);
+    }
+    std::unique_ptr<MdssSender> mdssSender;
+    if (const std::string& mdssAddress = ConfigProvider::instance().mdssAddress(); !mdssAddress.empty()) {
+        mdssSender = std::make_unique<MdssSender>(ioCtx, mdssAddress);
+    }
     GnssReader reader(ioCtx, ConfigProvider::instance().serialPort());
-    AsioCanSocket canSkt("can0", ioCtx);
+    std::unique_ptr<RtcmSource> rtcmSource;
+    if (const std::string& source = ConfigProvider::instance().rtcmSource(); !source.empty()) {
+        rtcmSource = std::make_unique<RtcmSource>(ioCtx, source);
+    }
+    AsioCanSocket canSkt(ConfigProvider::instance().canInterface(), ioCtx);
+    std::unique_ptr<CanReplaySource> canReplay;
+    if (const std::string& replayFile = ConfigProvider::instance().canReplayFile(); !replayFile.empty()) {
+        canReplay = std::make_unique<CanReplaySource>(ioCtx, canSkt, replayFile, ConfigProvider::instance().canReplaySpeed());
+    }
 
     ioThread.join();
     return 0;
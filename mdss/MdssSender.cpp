@@ -0,0 +1,133 @@
+#include "MdssSender.h"
+
+#include <charconv>
+#include <cmath>
+#include <limits>
+#include <boost/asio/ip/address.hpp>
+
+#include "../config/ConfigProvider.h"
+#include "../logging/Logger.h"
+
+template<typename T>
+static void putBigEndian(uint8_t* out, const T value) {
+    for (size_t i = 0; i < sizeof(T); i++) {
+        out[i] = static_cast<uint8_t>(static_cast<std::make_unsigned_t<T>>(value) >> (8 * (sizeof(T) - 1 - i)));
+    }
+}
+
+/// Scales a value into T, sending unknown or out of range values as T's maximum
+template<typename T>
+static T scaled(const double value, const double scale) {
+    const double result = std::round(value * scale);
+    if (!std::isfinite(result) || result < static_cast<double>(std::numeric_limits<T>::min()) ||
+        result >= static_cast<double>(std::numeric_limits<T>::max())) {
+        return std::numeric_limits<T>::max();
+    }
+    return static_cast<T>(result);
+}
+
+std::array<uint8_t, MDSS_FRAME_SIZE> encodeMdssFrame(const PositionEvent& ev, const uint16_t boatNumber,
+                                                     const uint32_t sequence, const unsigned long long timestamp) {
+    std::array<uint8_t, MDSS_FRAME_SIZE> frame{};
+    frame[0] = MDSS_FRAME_VERSION;
+    frame[1] = static_cast<uint8_t>((ev.fixValid ? MDSS_FLAG_FIX_VALID : 0) |
+                                    (ev.source == N2K ? MDSS_FLAG_SOURCE_N2K : 0) | ev.fixQuality << 4);
+    putBigEndian(&frame[2], boatNumber);
+    putBigEndian(&frame[4], sequence);
+    putBigEndian(&frame[8], static_cast<uint64_t>(timestamp));
+    putBigEndian(&frame[16], scaled<int32_t>(ev.latitude, 1e7));
+    putBigEndian(&frame[20], scaled<int32_t>(ev.longitude, 1e7));
+    putBigEndian(&frame[24], scaled<int32_t>(ev.altitude, 100));
+    //Speed is in m/s and heading in degrees, as the location provider publishes them
+    putBigEndian(&frame[28], scaled<uint16_t>(ev.speed, 100));
+    putBigEndian(&frame[30], scaled<uint16_t>(ev.heading, 100));
+    putBigEndian(&frame[32], scaled<uint16_t>(ev.hAccuracy, 100));
+    putBigEndian(&frame[34], scaled<uint16_t>(ev.vAccuracy, 100));
+    putBigEndian(&frame[36], scaled<uint16_t>(ev.hdop, 100));
+    putBigEndian(&frame[38], scaled<uint16_t>(ev.correctionAge, 10));
+    return frame;
+}
+
+MdssSender::MdssSender(boost::asio::io_context& ioCtx, const std::string& address): socket_(ioCtx), timer_(ioCtx) {
+    const ConfigProvider& config = ConfigProvider::instance();
+    boatNumber_ = static_cast<uint16_t>(config.riedelBoatNumber());
+    interval_ = config.mdssRate() > 0 ? steady_clock::duration(milliseconds(1000 / config.mdssRate()))
+                                      : steady_clock::duration::zero();
+
+    //host[:port], MDSS is addressed by IP on the race network so no resolver is involved
+    std::string host = address;
+    auto port = static_cast<unsigned short>(config.mdssPort());
+    bool portValid = true;
+    if (const size_t colon = address.rfind(':'); colon != std::string::npos && address.find(':') == colon) {
+        host = address.substr(0, colon);
+        portValid = std::from_chars(address.data() + colon + 1, address.data() + address.size(), port).ec == std::errc{};
+    }
+    boost::system::error_code ec;
+    const auto ip = boost::asio::ip::make_address(host, ec);
+    if (ec || !portValid) {
+        Logger::instance().error("MdssSender", "Invalid MDSS address " + address);
+        return;
+    }
+    endpoint_ = boost::asio::ip::udp::endpoint(ip, port);
+    socket_.open(endpoint_.protocol(), ec);
+    if (!ec) {
+        socket_.non_blocking(true, ec);
+    }
+    if (ec) {
+        Logger::instance().error("MdssSender", "Failed to open UDP socket - " + ec.message());
+        return;
+    }
+    Logger::instance().info("MdssSender", "Sending positions for boat " + std::to_string(boatNumber_) + " to " +
+                            endpoint_.address().to_string() + ":" + std::to_string(endpoint_.port()));
+    EventDispatcher::instance().subscribe<&MdssSender::handlePositionEvent>(this);
+}
+
+MdssSender::~MdssSender() {
+    EventDispatcher::instance().unsubscribe(this);
+}
+
+void MdssSender::handlePositionEvent(const PositionEvent& ev) {
+    std::lock_guard lock(lock_);
+    pending_ = ev;
+    havePending_ = true;
+    if (timerArmed_) {
+        return;
+    }
+    const steady_clock::time_point due = lastSend_ + interval_;
+    if (steady_clock::now() >= due) {
+        sendPending();
+        return;
+    }
+    timerArmed_ = true;
+    timer_.expires_at(due);
+    timer_.async_wait([this](const boost::system::error_code& ec) {
+        if (ec) {
+            return;
+        }
+        std::lock_guard timerLock(lock_);
+        timerArmed_ = false;
+        sendPending();
+    });
+}
+
+void MdssSender::sendPending() {
+    //Called with lock_ held
+    if (!havePending_) {
+        return;
+    }
+    havePending_ = false;
+    lastSend_ = steady_clock::now();
+    const auto frame = encodeMdssFrame(pending_, boatNumber_, sequence_++, systemTimeMillis());
+    boost::system::error_code ec;
+    socket_.send_to(boost::asio::buffer(frame), endpoint_, 0, ec);
+    if (ec) {
+        //Sequence numbers still advance, so the receiver sees this as loss
+        if (sendFailures_++ == 0) {
+            Logger::instance().warn("MdssSender", "Failed to send position - " + ec.message());
+        }
+    } else if (sendFailures_ > 0) {
+        Logger::instance().info("MdssSender", "Sending again after " + std::to_string(sendFailures_) +
+                                " failed updates");
+        sendFailures_ = 0;
+    }
+}
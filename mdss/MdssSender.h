@@ -0,0 +1,67 @@
+#ifndef MDSSSENDER_H
+#define MDSSSENDER_H
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/udp.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "../event/EventDispatcher.h"
+#include "../utils/TimeUtils.h"
+
+static constexpr size_t MDSS_FRAME_SIZE = 40;
+static constexpr uint8_t MDSS_FRAME_VERSION = 1;
+
+//Frame flags
+static constexpr uint8_t MDSS_FLAG_FIX_VALID = 0x01;
+static constexpr uint8_t MDSS_FLAG_SOURCE_N2K = 0x02;
+
+///
+/// Reports the boat's position to MDSS, the race management system, as one fixed-size UDP datagram per update. All
+/// fields are big endian:
+///   0  u8  version              1  u8  flags, fix quality in bits 4-7
+///   2  u16 riedelBoatNumber     4  u32 sequence, for loss measurement at the receiver
+///   8  u64 UTC milliseconds    16  i32 latitude, 1e-7 degrees     20  i32 longitude, 1e-7 degrees
+///  24  i32 altitude, cm        28  u16 SOG, cm/s                  30  u16 COG, 0.01 degrees
+///  32  u16 horizontal accuracy, cm    34  u16 vertical accuracy, cm
+///  36  u16 HDOP, 0.01          38  u16 correction age, 0.1 s
+/// Values that are not known are sent as the largest value of their type.
+///
+std::array<uint8_t, MDSS_FRAME_SIZE> encodeMdssFrame(const PositionEvent& ev, uint16_t boatNumber, uint32_t sequence,
+                                                     unsigned long long timestamp);
+
+///
+/// Sends every PositionEvent to mdssAddress, at most mdssRate times a second. An update that arrives inside the
+/// interval is held and sent when the interval ends, so MDSS always ends up with the latest position. Sending is a
+/// single non-blocking sendto from whichever thread has the update; a full socket buffer drops that frame rather than
+/// delaying the next.
+///
+class MdssSender final : public EventListener {
+public:
+    MdssSender(boost::asio::io_context& ioCtx, const std::string& address);
+    ~MdssSender() override;
+    [[nodiscard]] bool serialized() const override { return true; }
+
+private:
+    boost::asio::ip::udp::socket socket_;
+    boost::asio::ip::udp::endpoint endpoint_;
+    boost::asio::steady_timer timer_;
+    uint16_t boatNumber_;
+    steady_clock::duration interval_;
+
+    std::mutex lock_;
+    PositionEvent pending_;
+    bool havePending_ = false;
+    bool timerArmed_ = false;
+    steady_clock::time_point lastSend_;
+    uint32_t sequence_ = 0;
+    unsigned long long sendFailures_ = 0;
+
+    void handlePositionEvent(const PositionEvent& ev);
+    void sendPending();
+};
+
+#endif //MDSSSENDER_H
@@ -0,0 +1,172 @@
+#ifndef SPOOLRECORD_H
+#define SPOOLRECORD_H
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "../event/Event.h"
+
+//Every record starts with this header: crc32, payload length, type, a reserved byte and the millisecond timestamp
+static constexpr size_t SPOOL_RECORD_HEADER_SIZE = 16;
+static constexpr size_t SPOOL_MAX_PAYLOAD = 65535;
+
+enum SpoolRecordType : uint8_t {
+    SPOOL_NONE = 0,
+    SPOOL_PROPERTY,
+    SPOOL_POSITION
+};
+
+enum SpoolValueKind : uint8_t {
+    SPOOL_VALUE_NUMBER = 0,
+    SPOOL_VALUE_TEXT
+};
+
+///
+/// A record as handed to a cursor reader. The payload points into the mapped segment and is only valid inside the
+/// read callback.
+///
+struct SpoolRecord {
+    SpoolRecordType type = SPOOL_NONE;
+    unsigned long long timestamp = 0; //UTC milliseconds since the Unix epoch
+    std::string_view payload;
+};
+
+///
+/// One value of a property record. Values that parse as a number are stored as a double, anything else (dictionary
+/// lookups, "Not available") as text.
+///
+struct SpoolPropertyValue {
+    std::string_view propertyUid;
+    std::string_view instance;
+    SpoolValueKind kind = SPOOL_VALUE_NUMBER;
+    double number = 0;
+    std::string_view text;
+};
+
+inline void spoolPutString(std::string& out, const std::string_view value) {
+    //Uids, instances and dictionary values are short, anything longer is cut at 255 bytes
+    const size_t length = std::min<size_t>(value.size(), 255);
+    out.push_back(static_cast<char>(length));
+    out.append(value.data(), length);
+}
+
+inline bool spoolGetString(std::string_view& in, std::string_view& value) {
+    if (in.empty()) {
+        return false;
+    }
+    const size_t length = static_cast<uint8_t>(in[0]);
+    if (in.size() < 1 + length) {
+        return false;
+    }
+    value = in.substr(1, length);
+    in.remove_prefix(1 + length);
+    return true;
+}
+
+template<typename T>
+void spoolPut(std::string& out, const T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    out.append(bytes, sizeof(T));
+}
+
+template<typename T>
+bool spoolGet(std::string_view& in, T& value) {
+    if (in.size() < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, in.data(), sizeof(T));
+    in.remove_prefix(sizeof(T));
+    return true;
+}
+
+///
+/// Property payload: device uid, then for each value its property uid, instance, kind and either an 8 byte double or
+/// the text. Strings are length prefixed with a single byte.
+///
+inline void encodeSpoolProperty(const NMEAPropertyEvent& ev, std::string& out) {
+    out.clear();
+    spoolPutString(out, ev.deviceUid);
+    for (const auto& record : ev.values()) {
+        spoolPutString(out, record.propertyUid);
+        spoolPutString(out, record.instance);
+        double number;
+        const auto res = std::from_chars(record.value.data(), record.value.data() + record.value.size(), number);
+        if (res.ec == std::errc{} && res.ptr == record.value.data() + record.value.size()) {
+            out.push_back(static_cast<char>(SPOOL_VALUE_NUMBER));
+            spoolPut(out, number);
+        } else {
+            out.push_back(static_cast<char>(SPOOL_VALUE_TEXT));
+            spoolPutString(out, record.value);
+        }
+    }
+}
+
+///
+/// Walks a property payload, calling visitor(const SpoolPropertyValue&) for every value. Returns false if the payload
+/// is truncated or malformed.
+///
+template<typename F>
+bool decodeSpoolProperty(std::string_view payload, std::string_view& deviceUid, F&& visitor) {
+    if (!spoolGetString(payload, deviceUid)) {
+        return false;
+    }
+    while (!payload.empty()) {
+        SpoolPropertyValue value;
+        uint8_t kind;
+        if (!spoolGetString(payload, value.propertyUid) || !spoolGetString(payload, value.instance) ||
+            !spoolGet(payload, kind)) {
+            return false;
+        }
+        value.kind = static_cast<SpoolValueKind>(kind);
+        if (value.kind == SPOOL_VALUE_NUMBER) {
+            if (!spoolGet(payload, value.number)) {
+                return false;
+            }
+        } else if (!spoolGetString(payload, value.text)) {
+            return false;
+        }
+        visitor(value);
+    }
+    return true;
+}
+
+///
+/// Position payload: four bytes of source, fix quality, fix valid and selection reason followed by the ten doubles
+/// in PositionEvent order.
+///
+inline void encodeSpoolPosition(const PositionEvent& ev, std::string& out) {
+    out.clear();
+    out.push_back(static_cast<char>(ev.source));
+    out.push_back(static_cast<char>(ev.fixQuality));
+    out.push_back(static_cast<char>(ev.fixValid));
+    out.push_back(static_cast<char>(ev.selectionReason));
+    for (const double value : {ev.latitude, ev.longitude, ev.altitude, ev.hAccuracy, ev.vAccuracy, ev.speed,
+                               ev.heading, ev.vVelocity, ev.correctionAge, ev.hdop}) {
+        spoolPut(out, value);
+    }
+}
+
+inline bool decodeSpoolPosition(std::string_view payload, PositionEvent& ev) {
+    uint8_t flags[4];
+    if (!spoolGet(payload, flags)) {
+        return false;
+    }
+    ev.source = static_cast<GNSSSource>(flags[0]);
+    ev.fixQuality = static_cast<GNSSFixQuality>(flags[1]);
+    ev.fixValid = flags[2] != 0;
+    ev.selectionReason = static_cast<SourceSelectionReason>(flags[3]);
+    for (double* value : {&ev.latitude, &ev.longitude, &ev.altitude, &ev.hAccuracy, &ev.vAccuracy, &ev.speed,
+                          &ev.heading, &ev.vVelocity, &ev.correctionAge, &ev.hdop}) {
+        if (!spoolGet(payload, *value)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+#endif //SPOOLRECORD_H
@@ -0,0 +1,410 @@
+#include "TelemetrySpool.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#include "../config/ConfigProvider.h"
+#include "../logging/Logger.h"
+#include "../utils/TimeUtils.h"
+
+static uint32_t recordCrc(const uint8_t* header, const uint8_t* payload, const size_t length) {
+    //Covers everything in the header after the crc itself
+    uLong crc = crc32(0L, header + 4, SPOOL_RECORD_HEADER_SIZE - 4);
+    return static_cast<uint32_t>(crc32(crc, payload, static_cast<uInt>(length)));
+}
+
+TelemetrySpool::TelemetrySpool(boost::asio::io_context& ioCtx, const std::string& directory): syncTimer_(ioCtx),
+    directory_(directory) {
+    const ConfigProvider& config = ConfigProvider::instance();
+    segmentSize_ = static_cast<size_t>(std::max(config.telemetrySpoolSegmentSize(), 1)) * 1024 * 1024;
+    maxSegments_ = std::max<size_t>(static_cast<size_t>(std::max(config.telemetrySpoolLimit(), 0)) * 1024 * 1024 /
+                                    segmentSize_, 2);
+    std::error_code ec;
+    std::filesystem::create_directories(directory_, ec);
+    if (ec) {
+        Logger::instance().error("TelemetrySpool", "Cannot create spool directory " + directory_ + " - " + ec.message());
+        directory_.clear();
+        failed_ = true;
+    } else {
+        recover();
+    }
+    EventDispatcher::instance().subscribe<&TelemetrySpool::handlePropertyEvent>(this);
+    EventDispatcher::instance().subscribe<&TelemetrySpool::handlePositionEvent>(this);
+    scheduleSync();
+}
+
+TelemetrySpool::~TelemetrySpool() {
+    EventDispatcher::instance().unsubscribe(this);
+    syncTimer_.cancel();
+    std::lock_guard lock(lock_);
+    for (auto& segment : segments_) {
+        closeSegment(segment, false);
+    }
+    if (droppedRecords_ > 0) {
+        Logger::instance().warn("TelemetrySpool", std::to_string(droppedRecords_) + " records could not be spooled");
+    }
+}
+
+void TelemetrySpool::handlePropertyEvent(const NMEAPropertyEvent& ev) {
+    //Serialized, so the scratch buffer is never shared between the two handlers
+    encodeSpoolProperty(ev, scratch_);
+    append(SPOOL_PROPERTY, systemTimeMillis(), scratch_);
+}
+
+void TelemetrySpool::handlePositionEvent(const PositionEvent& ev) {
+    encodeSpoolPosition(ev, scratch_);
+    append(SPOOL_POSITION, systemTimeMillis(), scratch_);
+}
+
+void TelemetrySpool::append(const SpoolRecordType type, const unsigned long long timestamp,
+                            const std::string_view payload) {
+    std::lock_guard lock(lock_);
+    const size_t recordSize = SPOOL_RECORD_HEADER_SIZE + payload.size();
+    if (payload.size() > SPOOL_MAX_PAYLOAD || recordSize > segmentSize_ - SPOOL_SEGMENT_HEADER_SIZE) {
+        droppedRecords_++;
+        return;
+    }
+    if (!activeWritable_ || segments_.back().end + recordSize > segments_.back().size) {
+        if (!rotate()) {
+            droppedRecords_++;
+            return;
+        }
+    }
+    Segment& segment = segments_.back();
+    uint8_t* header = segment.data + segment.end;
+    uint8_t* body = header + SPOOL_RECORD_HEADER_SIZE;
+    const auto length = static_cast<uint16_t>(payload.size());
+    std::memcpy(body, payload.data(), payload.size());
+    std::memcpy(header + 4, &length, sizeof(length));
+    header[6] = type;
+    header[7] = 0;
+    std::memcpy(header + 8, &timestamp, sizeof(timestamp));
+    const uint32_t crc = recordCrc(header, body, payload.size());
+    std::memcpy(header, &crc, sizeof(crc));
+    segment.end += recordSize;
+}
+
+SpoolCursor& TelemetrySpool::openCursor(const std::string& name) {
+    std::lock_guard lock(lock_);
+    for (const auto& cursor : cursors_) {
+        if (cursor->name == name) {
+            return *cursor;
+        }
+    }
+    auto cursor = std::make_unique<SpoolCursor>();
+    cursor->name = name;
+    //Without a saved position everything still in the spool is replayed
+    std::ifstream file(directory_ + "/" + name + ".cursor");
+    if (file >> cursor->committedSequence >> cursor->committedOffset) {
+        Logger::instance().info("TelemetrySpool", "Cursor " + name + " resuming at segment " +
+                                std::to_string(cursor->committedSequence));
+    } else {
+        cursor->committedSequence = 0;
+        cursor->committedOffset = SPOOL_SEGMENT_HEADER_SIZE;
+    }
+    cursor->sequence = cursor->committedSequence;
+    cursor->offset = cursor->committedOffset;
+    cursors_.push_back(std::move(cursor));
+    return *cursors_.back();
+}
+
+void TelemetrySpool::commit(SpoolCursor& cursor) {
+    std::lock_guard lock(lock_);
+    cursor.committedSequence = cursor.sequence;
+    cursor.committedOffset = cursor.offset;
+    writeCursor(cursor);
+    removeConsumed();
+}
+
+void TelemetrySpool::rewind(SpoolCursor& cursor) {
+    std::lock_guard lock(lock_);
+    cursor.sequence = cursor.committedSequence;
+    cursor.offset = cursor.committedOffset;
+}
+
+void TelemetrySpool::writeCursor(const SpoolCursor& cursor) const {
+    //Written aside and renamed over, so a crash leaves either the old or the new position. Losing the rename to a
+    //power cut only means replaying a little again.
+    const std::string path = directory_ + "/" + cursor.name + ".cursor";
+    {
+        std::ofstream file(path + ".tmp", std::ios::trunc);
+        file << cursor.committedSequence << ' ' << cursor.committedOffset << '\n';
+        if (!file) {
+            Logger::instance().error("TelemetrySpool", "Failed to write cursor " + path);
+            return;
+        }
+    }
+    std::error_code ec;
+    std::filesystem::rename(path + ".tmp", path, ec);
+}
+
+bool TelemetrySpool::nextRecord(SpoolCursor& cursor, SpoolRecord& record) {
+    while (true) {
+        size_t index = segmentIndex(cursor.sequence);
+        if (index == segments_.size()) {
+            //The segment was evicted or removed, carry on from the next one that still exists
+            const auto it = std::ranges::find_if(segments_, [&](const Segment& segment) {
+                return segment.sequence > cursor.sequence;
+            });
+            if (it == segments_.end()) {
+                return false;
+            }
+            cursor.sequence = it->sequence;
+            cursor.offset = SPOOL_SEGMENT_HEADER_SIZE;
+            continue;
+        }
+        const Segment& segment = segments_[index];
+        if (cursor.offset + SPOOL_RECORD_HEADER_SIZE <= segment.end) {
+            //Everything below end was either written by this process or checked on recovery
+            const uint8_t* header = segment.data + cursor.offset;
+            uint16_t length;
+            std::memcpy(&length, header + 4, sizeof(length));
+            record.type = static_cast<SpoolRecordType>(header[6]);
+            std::memcpy(&record.timestamp, header + 8, sizeof(record.timestamp));
+            record.payload = std::string_view(reinterpret_cast<const char*>(header + SPOOL_RECORD_HEADER_SIZE), length);
+            cursor.offset += SPOOL_RECORD_HEADER_SIZE + length;
+            return true;
+        }
+        if (++index == segments_.size()) {
+            return false;
+        }
+        cursor.sequence = segments_[index].sequence;
+        cursor.offset = SPOOL_SEGMENT_HEADER_SIZE;
+    }
+}
+
+size_t TelemetrySpool::segmentIndex(const unsigned long long sequence) const {
+    //Sequences only grow, so the index is usually the difference from the front
+    if (!segments_.empty() && sequence >= segments_.front().sequence) {
+        const size_t guess = sequence - segments_.front().sequence;
+        if (guess < segments_.size() && segments_[guess].sequence == sequence) {
+            return guess;
+        }
+    }
+    for (size_t i = 0; i < segments_.size(); i++) {
+        if (segments_[i].sequence == sequence) {
+            return i;
+        }
+    }
+    return segments_.size();
+}
+
+std::string TelemetrySpool::segmentPath(const unsigned long long sequence) const {
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%016llu.seg", sequence);
+    return directory_ + name;
+}
+
+void TelemetrySpool::recover() {
+    std::vector<unsigned long long> sequences;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(directory_, ec)) {
+        const std::string name = entry.path().filename().string();
+        unsigned long long sequence;
+        if (entry.is_regular_file() && name.ends_with(".seg") &&
+            std::from_chars(name.data(), name.data() + name.size() - 4, sequence).ec == std::errc{}) {
+            sequences.push_back(sequence);
+        }
+    }
+    std::ranges::sort(sequences);
+    size_t recoveredBytes = 0;
+    for (const auto sequence : sequences) {
+        Segment segment;
+        segment.sequence = sequence;
+        if (!openSegment(segment, segmentPath(sequence), false)) {
+            Logger::instance().warn("TelemetrySpool", "Discarding unreadable segment " + segmentPath(sequence));
+            std::filesystem::remove(segmentPath(sequence), ec);
+            continue;
+        }
+        recoveredBytes += segment.end - SPOOL_SEGMENT_HEADER_SIZE;
+        segments_.push_back(segment);
+    }
+    while (segments_.size() > maxSegments_) {
+        evictOldest();
+    }
+    if (!segments_.empty()) {
+        Logger::instance().info("TelemetrySpool", "Recovered " + std::to_string(segments_.size()) + " segments, " +
+                                std::to_string(recoveredBytes / 1024) + " KB of records");
+    }
+}
+
+bool TelemetrySpool::openSegment(Segment& segment, const std::string& path, const bool create) {
+    segment.fd = create ? open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644)
+                        : open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (segment.fd < 0) {
+        return false;
+    }
+    if (create) {
+        segment.size = segmentSize_;
+        if (ftruncate(segment.fd, static_cast<off_t>(segment.size)) != 0) {
+            closeSegment(segment, true);
+            return false;
+        }
+    } else {
+        struct stat st{};
+        if (fstat(segment.fd, &st) != 0 || static_cast<size_t>(st.st_size) < SPOOL_SEGMENT_HEADER_SIZE) {
+            closeSegment(segment, false);
+            return false;
+        }
+        segment.size = static_cast<size_t>(st.st_size);
+    }
+    void* data = mmap(nullptr, segment.size, create ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, segment.fd, 0);
+    if (data == MAP_FAILED) {
+        closeSegment(segment, create);
+        return false;
+    }
+    segment.data = static_cast<uint8_t*>(data);
+    if (create) {
+        std::memcpy(segment.data, SPOOL_SEGMENT_MAGIC, sizeof(SPOOL_SEGMENT_MAGIC));
+        segment.end = SPOOL_SEGMENT_HEADER_SIZE;
+        segment.synced = 0;
+        return true;
+    }
+    if (std::memcmp(segment.data, SPOOL_SEGMENT_MAGIC, sizeof(SPOOL_SEGMENT_MAGIC)) != 0) {
+        closeSegment(segment, false);
+        return false;
+    }
+    //Valid records run up to the first one that is zeroed, torn or fails its crc
+    size_t offset = SPOOL_SEGMENT_HEADER_SIZE;
+    size_t next;
+    while (validRecord(segment, offset, next)) {
+        offset = next;
+    }
+    segment.end = offset;
+    segment.synced = offset;
+    return true;
+}
+
+bool TelemetrySpool::validRecord(const Segment& segment, const size_t offset, size_t& next) {
+    if (offset + SPOOL_RECORD_HEADER_SIZE > segment.size) {
+        return false;
+    }
+    const uint8_t* header = segment.data + offset;
+    uint16_t length;
+    uint32_t crc;
+    std::memcpy(&length, header + 4, sizeof(length));
+    std::memcpy(&crc, header, sizeof(crc));
+    if (header[6] != SPOOL_PROPERTY && header[6] != SPOOL_POSITION) {
+        return false;
+    }
+    if (offset + SPOOL_RECORD_HEADER_SIZE + length > segment.size ||
+        recordCrc(header, header + SPOOL_RECORD_HEADER_SIZE, length) != crc) {
+        return false;
+    }
+    next = offset + SPOOL_RECORD_HEADER_SIZE + length;
+    return true;
+}
+
+bool TelemetrySpool::rotate() {
+    //After a failure we wait for the next sync tick before touching the disk again
+    if (failed_) {
+        return false;
+    }
+    if (activeWritable_) {
+        startWriteback(segments_.back());
+    }
+    activeWritable_ = false;
+    while (segments_.size() >= maxSegments_) {
+        evictOldest();
+    }
+    Segment segment;
+    segment.sequence = segments_.empty() ? 1 : segments_.back().sequence + 1;
+    if (!openSegment(segment, segmentPath(segment.sequence), true)) {
+        Logger::instance().error("TelemetrySpool", "Failed to create segment " + segmentPath(segment.sequence) +
+                                 " - " + std::strerror(errno));
+        failed_ = true;
+        return false;
+    }
+    segments_.push_back(segment);
+    activeWritable_ = true;
+    return true;
+}
+
+void TelemetrySpool::evictOldest() {
+    Segment& oldest = segments_.front();
+    std::string unsent;
+    for (const auto& cursor : cursors_) {
+        if (cursor->committedSequence <= oldest.sequence) {
+            unsent += (unsent.empty() ? "" : ", ") + cursor->name;
+        }
+    }
+    //Cursors inside the segment move on to the next one the next time they read
+    Logger::instance().warn("TelemetrySpool", "Spool full, discarding segment " + std::to_string(oldest.sequence) +
+                            (unsent.empty() ? "" : " unsent to " + unsent));
+    closeSegment(oldest, true);
+    segments_.pop_front();
+}
+
+void TelemetrySpool::removeConsumed() {
+    if (cursors_.empty()) {
+        return;
+    }
+    while (segments_.size() > 1) {
+        const unsigned long long oldest = segments_.front().sequence;
+        const bool consumed = std::ranges::all_of(cursors_, [&](const auto& cursor) {
+            return cursor->committedSequence > oldest;
+        });
+        if (!consumed) {
+            return;
+        }
+        closeSegment(segments_.front(), true);
+        segments_.pop_front();
+    }
+}
+
+void TelemetrySpool::closeSegment(Segment& segment, const bool remove) {
+    const bool writable = activeWritable_ && !segments_.empty() && &segment == &segments_.back();
+    if (segment.data != nullptr) {
+        munmap(segment.data, segment.size);
+        segment.data = nullptr;
+    }
+    if (segment.fd >= 0) {
+        //On a clean shutdown the unused tail of the active segment is given back
+        if (writable && !remove && ftruncate(segment.fd, static_cast<off_t>(segment.end)) == 0) {
+            segment.size = segment.end;
+        }
+        close(segment.fd);
+        segment.fd = -1;
+    }
+    if (remove) {
+        std::error_code ec;
+        std::filesystem::remove(segmentPath(segment.sequence), ec);
+    }
+}
+
+void TelemetrySpool::startWriteback(Segment& segment) {
+    if (segment.end <= segment.synced) {
+        return;
+    }
+    //Queue the new pages for writeback without waiting for them
+    const size_t from = segment.synced & ~static_cast<size_t>(4095);
+    sync_file_range(segment.fd, static_cast<off_t>(from), static_cast<off_t>(segment.end - from),
+                    SYNC_FILE_RANGE_WRITE);
+    segment.synced = segment.end;
+}
+
+void TelemetrySpool::scheduleSync() {
+    syncTimer_.expires_after(boost::asio::chrono::milliseconds(SPOOL_SYNC_INTERVAL_MS));
+    syncTimer_.async_wait([this](const boost::system::error_code& ec) {
+        if (ec) {
+            return;
+        }
+        {
+            std::lock_guard lock(lock_);
+            if (activeWritable_) {
+                startWriteback(segments_.back());
+            }
+            //Without a directory there is nothing to retry
+            failed_ = directory_.empty();
+        }
+        scheduleSync();
+    });
+}
@@ -0,0 +1,113 @@
+#ifndef TELEMETRYSPOOL_H
+#define TELEMETRYSPOOL_H
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/steady_timer.hpp>
+
+#include "SpoolRecord.h"
+#include "../event/EventDispatcher.h"
+
+//Segment files start with an 8 byte magic and 8 reserved bytes, records follow
+static constexpr char SPOOL_SEGMENT_MAGIC[8] = {'S', 'G', 'P', 'S', 'P', 'O', 'O', 'L'};
+static constexpr size_t SPOOL_SEGMENT_HEADER_SIZE = 16;
+//How often writeback of the active segment is started, bounding what a power cut can take
+static constexpr unsigned int SPOOL_SYNC_INTERVAL_MS = 1000;
+
+///
+/// A named read position in the spool. read advances it, commit persists it to <name>.cursor in the spool directory
+/// and rewind goes back to the last commit, so a sink only commits once the uplink has acknowledged what it read.
+///
+struct SpoolCursor {
+    std::string name;
+    unsigned long long sequence = 0;
+    size_t offset = SPOOL_SEGMENT_HEADER_SIZE;
+    unsigned long long committedSequence = 0;
+    size_t committedOffset = SPOOL_SEGMENT_HEADER_SIZE;
+};
+
+///
+/// Append-only spool of decoded property and position records, so an uplink outage costs disk rather than data.
+/// Records go into fixed-size segment files mapped with MAP_SHARED; an append is a memcpy into the page cache, which
+/// survives a crash of the process, and writeback is started once a second rather than syncing every record. Each
+/// record carries a CRC so a torn tail after a power cut is found on startup. Disk use is capped at the spool limit
+/// by discarding the oldest segment, and segments every cursor has committed past are removed.
+///
+class TelemetrySpool final : public EventListener {
+public:
+    TelemetrySpool(boost::asio::io_context& ioCtx, const std::string& directory);
+    ~TelemetrySpool() override;
+    [[nodiscard]] bool serialized() const override { return true; }
+
+    /// Opens or creates the named cursor, resuming from its last committed position
+    SpoolCursor& openCursor(const std::string& name);
+
+    ///
+    /// Calls visitor(const SpoolRecord&) for each record after the cursor until it returns false or the spool is
+    /// exhausted. Runs with the spool locked, so the visitor should only copy or format the record.
+    ///
+    template<typename F>
+    size_t read(SpoolCursor& cursor, F&& visitor) {
+        std::lock_guard lock(lock_);
+        size_t count = 0;
+        SpoolRecord record;
+        while (nextRecord(cursor, record)) {
+            count++;
+            if (!visitor(record)) {
+                break;
+            }
+        }
+        return count;
+    }
+
+    void commit(SpoolCursor& cursor);
+    void rewind(SpoolCursor& cursor);
+
+    void append(SpoolRecordType type, unsigned long long timestamp, std::string_view payload);
+
+private:
+    struct Segment {
+        unsigned long long sequence = 0;
+        int fd = -1;
+        uint8_t* data = nullptr;
+        size_t size = 0;
+        size_t end = SPOOL_SEGMENT_HEADER_SIZE; //Bytes of valid records, including the segment header
+        size_t synced = 0;
+    };
+
+    boost::asio::steady_timer syncTimer_;
+    std::string directory_;
+    size_t segmentSize_;
+    size_t maxSegments_;
+    std::mutex lock_;
+    std::deque<Segment> segments_;
+    //Only the segment created by this process is written to, recovered segments are read only
+    bool activeWritable_ = false;
+    bool failed_ = false;
+    std::vector<std::unique_ptr<SpoolCursor>> cursors_;
+    std::string scratch_;
+    unsigned long long droppedRecords_ = 0;
+
+    void handlePropertyEvent(const NMEAPropertyEvent& ev);
+    void handlePositionEvent(const PositionEvent& ev);
+    void recover();
+    bool openSegment(Segment& segment, const std::string& path, bool create);
+    bool rotate();
+    void evictOldest();
+    void removeConsumed();
+    void closeSegment(Segment& segment, bool remove);
+    void startWriteback(Segment& segment);
+    void scheduleSync();
+    void writeCursor(const SpoolCursor& cursor) const;
+    bool nextRecord(SpoolCursor& cursor, SpoolRecord& record);
+    [[nodiscard]] size_t segmentIndex(unsigned long long sequence) const;
+    [[nodiscard]] std::string segmentPath(unsigned long long sequence) const;
+    static bool validRecord(const Segment& segment, size_t offset, size_t& next);
+};
+
+#endif //TELEMETRYSPOOL_H
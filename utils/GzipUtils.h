@@ -0,0 +1,34 @@
+#ifndef GZIPUTILS_H
+#define GZIPUTILS_H
+
+#include <string>
+#include <string_view>
+#include <zlib.h>
+
+///
+/// Compresses data into a complete gzip member, replacing the contents of out. Returns false if zlib fails, in which
+/// case out is left empty.
+///
+inline bool gzipCompress(const std::string_view data, std::string& out, const int level = Z_DEFAULT_COMPRESSION) {
+    out.clear();
+    z_stream zs{};
+    //15 window bits plus 16 selects the gzip wrapper rather than raw zlib
+    if (deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return false;
+    }
+    out.resize(deflateBound(&zs, data.size()));
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    zs.avail_in = static_cast<uInt>(data.size());
+    zs.next_out = reinterpret_cast<Bytef*>(out.data());
+    zs.avail_out = static_cast<uInt>(out.size());
+    const int res = deflate(&zs, Z_FINISH);
+    deflateEnd(&zs);
+    if (res != Z_STREAM_END) {
+        out.clear();
+        return false;
+    }
+    out.resize(zs.total_out);
+    return true;
+}
+
+#endif //GZIPUTILS_H
@@ -1,31 +1,160 @@
 #ifndef NMEAUTILS_H
 #define NMEAUTILS_H
 
-inline double nmeaPositionToDecimal(const std::string& nmeaCoordinate, const std::string& direction) {
-    double degrees = 0.0;
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <string_view>
 
-    if (nmeaCoordinate.size() > 2) {
-        // For latitude, the format is DDMM.MMMM
-        // For longitude, the format is DDDMM.MMMM
+static constexpr size_t NMEA_MAX_FIELDS = 40;
 
-        // Determine the number of degree digits based on the length of the string
-        const size_t degreeDigits = (direction == "E" || direction == "W") ? 3 : 2;
+///
+/// A tokenized NMEA 0183 sentence. All views point into the caller's receive buffer, so a sentence is only valid until
+/// that buffer is reused. fields holds the data fields after the address field, e.g. for "$GPGGA,123519,4807.038,N"
+/// fields[0] is "123519".
+///
+struct NmeaSentence {
+    std::string_view address;
+    std::string_view talker;
+    std::string_view sentenceId;
+    std::array<std::string_view, NMEA_MAX_FIELDS> fields = {};
+    size_t fieldCount = 0;
 
-        // Extract degrees
-        degrees = std::stod(nmeaCoordinate.substr(0, degreeDigits));
-        // Extract minutes
-        const double minutes = std::stod(nmeaCoordinate.substr(degreeDigits));
+    [[nodiscard]] std::string_view field(const size_t i) const {
+        return i < fieldCount ? fields[i] : std::string_view{};
+    }
 
-        // Convert to decimal degrees
-        degrees += (minutes / 60.0);
+    /// Parses a numeric field, empty or malformed fields read as NaN
+    [[nodiscard]] double number(const size_t i) const {
+        const std::string_view f = field(i);
+        double val = NAN;
+        if (std::from_chars(f.data(), f.data() + f.size(), val).ec != std::errc{}) {
+            return NAN;
+        }
+        return val;
+    }
 
-        // Adjust for the hemisphere (N/S for latitude, E/W for longitude)
-        if (direction == "S" || direction == "W") {
-            degrees = -degrees;
+    /// Parses an integer field, empty or malformed fields read as fallback
+    [[nodiscard]] long integer(const size_t i, const long fallback = 0) const {
+        const std::string_view f = field(i);
+        long val = fallback;
+        if (std::from_chars(f.data(), f.data() + f.size(), val).ec != std::errc{}) {
+            return fallback;
         }
+        return val;
     }
+};
+
+enum class NmeaParseResult {
+    OK = 0,
+    INVALID_START,
+    NO_CHECKSUM,
+    INVALID_CHECKSUM,
+    TOO_MANY_FIELDS
+};
 
+///
+/// Splits a sentence into fields and validates its checksum in a single pass over the line, without copying. The line
+/// must not include the trailing CR/LF.
+///
+inline NmeaParseResult parseNmeaSentence(const std::string_view line, NmeaSentence& out) {
+    if (line.size() < 2 || line[0] != '$') {
+        return NmeaParseResult::INVALID_START;
+    }
+    out.fieldCount = 0;
+    unsigned char checksum = 0;
+    size_t fieldStart = 1;
+    bool addressDone = false;
+    size_t i = 1;
+    for (; i < line.size() && line[i] != '*'; i++) {
+        checksum ^= static_cast<unsigned char>(line[i]);
+        if (line[i] == ',') {
+            if (!addressDone) {
+                out.address = line.substr(fieldStart, i - fieldStart);
+                addressDone = true;
+            } else if (out.fieldCount < NMEA_MAX_FIELDS) {
+                out.fields[out.fieldCount++] = line.substr(fieldStart, i - fieldStart);
+            } else {
+                return NmeaParseResult::TOO_MANY_FIELDS;
+            }
+            fieldStart = i + 1;
+        }
+    }
+    //The checksum is always the last thing on the line, a '*' followed by two hex digits
+    if (i + 3 != line.size()) {
+        return NmeaParseResult::NO_CHECKSUM;
+    }
+    unsigned int expected = 0;
+    if (const auto res = std::from_chars(line.data() + i + 1, line.data() + i + 3, expected, 16);
+        res.ec != std::errc{} || res.ptr != line.data() + i + 3) {
+        return NmeaParseResult::NO_CHECKSUM;
+    }
+    if (checksum != expected) {
+        return NmeaParseResult::INVALID_CHECKSUM;
+    }
+    const std::string_view last = line.substr(fieldStart, i - fieldStart);
+    if (!addressDone) {
+        out.address = last;
+    } else if (out.fieldCount < NMEA_MAX_FIELDS) {
+        out.fields[out.fieldCount++] = last;
+    } else {
+        return NmeaParseResult::TOO_MANY_FIELDS;
+    }
+    //Proprietary sentences ($P...) carry no talker, e.g. PUBX
+    if (!out.address.empty() && out.address[0] == 'P') {
+        out.talker = {};
+        out.sentenceId = out.address;
+    } else {
+        out.talker = out.address.substr(0, 2);
+        out.sentenceId = out.address.size() > 2 ? out.address.substr(2) : std::string_view{};
+    }
+    return NmeaParseResult::OK;
+}
+
+inline double nmeaPositionToDecimal(const std::string_view nmeaCoordinate, const std::string_view direction) {
+    if (nmeaCoordinate.size() <= 2) {
+        return NAN;
+    }
+    // For latitude, the format is DDMM.MMMM
+    // For longitude, the format is DDDMM.MMMM
+
+    // Determine the number of degree digits based on the length of the string
+    const size_t degreeDigits = (direction == "E" || direction == "W") ? 3 : 2;
+
+    int wholeDegrees = 0;
+    double minutes = 0.0;
+    const char* begin = nmeaCoordinate.data();
+    const char* end = begin + nmeaCoordinate.size();
+    if (std::from_chars(begin, begin + degreeDigits, wholeDegrees).ec != std::errc{} ||
+        std::from_chars(begin + degreeDigits, end, minutes).ec != std::errc{}) {
+        return NAN;
+    }
+
+    // Convert to decimal degrees
+    double degrees = wholeDegrees + (minutes / 60.0);
+
+    // Adjust for the hemisphere (N/S for latitude, E/W for longitude)
+    if (direction == "S" || direction == "W") {
+        degrees = -degrees;
+    }
     return degrees;
 }
 
+/// Converts a hhmmss.ss UTC time field to seconds since midnight, NaN when the field is empty or malformed
+inline double nmeaTimeToSeconds(const std::string_view nmeaTime) {
+    if (nmeaTime.size() < 6) {
+        return NAN;
+    }
+    int hours = 0;
+    int minutes = 0;
+    double seconds = 0.0;
+    const char* begin = nmeaTime.data();
+    if (std::from_chars(begin, begin + 2, hours).ec != std::errc{} ||
+        std::from_chars(begin + 2, begin + 4, minutes).ec != std::errc{} ||
+        std::from_chars(begin + 4, begin + nmeaTime.size(), seconds).ec != std::errc{}) {
+        return NAN;
+    }
+    return hours * 3600 + minutes * 60 + seconds;
+}
+
 #endif //NMEAUTILS_H
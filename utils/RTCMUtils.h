@@ -0,0 +1,117 @@
+#ifndef RTCMUTILS_H
+#define RTCMUTILS_H
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+static constexpr uint8_t RTCM_PREAMBLE = 0xD3;
+static constexpr size_t RTCM_HEADER_LENGTH = 3;
+static constexpr size_t RTCM_CRC_LENGTH = 3;
+static constexpr size_t RTCM_MAX_PAYLOAD = 1023;
+static constexpr size_t RTCM_MAX_FRAME = RTCM_HEADER_LENGTH + RTCM_MAX_PAYLOAD + RTCM_CRC_LENGTH;
+
+enum class RtcmParseResult {
+    OK = 0,
+    INCOMPLETE,
+    INVALID_START,
+    INVALID_CHECKSUM
+};
+
+///
+/// A framed RTCM3 message. Points into the buffer it was parsed from, frame covers the preamble through the CRC so it
+/// can be written to the receiver as is.
+///
+struct RtcmFrame {
+    uint16_t messageType = 0;
+    const uint8_t* frame = nullptr;
+    size_t length = 0;
+};
+
+static constexpr std::array<uint32_t, 256> makeCrc24qTable() {
+    std::array<uint32_t, 256> table{};
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i << 16;
+        for (int bit = 0; bit < 8; bit++) {
+            crc <<= 1;
+            if (crc & 0x1000000) {
+                crc ^= 0x1864CFB;
+            }
+        }
+        table[i] = crc & 0xFFFFFF;
+    }
+    return table;
+}
+
+static constexpr std::array<uint32_t, 256> CRC24Q_TABLE = makeCrc24qTable();
+
+inline uint32_t crc24q(const uint8_t* data, const size_t length) {
+    uint32_t crc = 0;
+    for (size_t i = 0; i < length; i++) {
+        crc = ((crc << 8) & 0xFFFFFF) ^ CRC24Q_TABLE[(crc >> 16) ^ data[i]];
+    }
+    return crc;
+}
+
+///
+/// Frames an RTCM3 message at the start of data: preamble, 6 reserved bits, 10 bit length, payload and CRC-24Q over
+/// everything before it. On OK consumed is the full frame length. INCOMPLETE means more bytes are needed; any other
+/// result means data does not start with a valid frame and the caller should resync from the next byte.
+///
+inline RtcmParseResult parseRtcmFrame(const std::string_view data, RtcmFrame& out, size_t& consumed) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    if (data.empty()) {
+        return RtcmParseResult::INCOMPLETE;
+    }
+    if (bytes[0] != RTCM_PREAMBLE) {
+        return RtcmParseResult::INVALID_START;
+    }
+    if (data.size() < RTCM_HEADER_LENGTH) {
+        return RtcmParseResult::INCOMPLETE;
+    }
+    if ((bytes[1] & 0xFC) != 0) {
+        return RtcmParseResult::INVALID_START;
+    }
+    const size_t length = static_cast<size_t>(bytes[1] & 0x03) << 8 | bytes[2];
+    const size_t frameLength = RTCM_HEADER_LENGTH + length + RTCM_CRC_LENGTH;
+    if (data.size() < frameLength) {
+        return RtcmParseResult::INCOMPLETE;
+    }
+    const uint32_t crc = static_cast<uint32_t>(bytes[frameLength - 3]) << 16 |
+                         static_cast<uint32_t>(bytes[frameLength - 2]) << 8 | bytes[frameLength - 1];
+    if (crc24q(bytes, RTCM_HEADER_LENGTH + length) != crc) {
+        return RtcmParseResult::INVALID_CHECKSUM;
+    }
+    //The message number is the first 12 bits of the payload
+    out.messageType = length >= 2 ? static_cast<uint16_t>(bytes[3] << 4 | bytes[4] >> 4) : 0;
+    out.frame = bytes;
+    out.length = frameLength;
+    consumed = frameLength;
+    return RtcmParseResult::OK;
+}
+
+enum RtcmPriority {
+    RTCM_PRIORITY_HIGH = 0,
+    RTCM_PRIORITY_NORMAL,
+    RTCM_PRIORITY_LOW,
+    RTCM_PRIORITY_COUNT
+};
+
+///
+/// Observations are what the RTK solution is computed from and go first; the reference station position and the
+/// receiver's own proprietary messages follow, and descriptors and biases that hardly change go last.
+///
+inline RtcmPriority rtcmPriority(const uint16_t messageType) {
+    //Legacy observations 1001-1004 and 1009-1012, MSM 1071-1137
+    if ((messageType >= 1001 && messageType <= 1004) || (messageType >= 1009 && messageType <= 1012) ||
+        (messageType >= 1071 && messageType <= 1137)) {
+        return RTCM_PRIORITY_HIGH;
+    }
+    //Station position, u-blox proprietary
+    if (messageType == 1005 || messageType == 1006 || messageType == 4072) {
+        return RTCM_PRIORITY_NORMAL;
+    }
+    return RTCM_PRIORITY_LOW;
+}
+
+#endif //RTCMUTILS_H
@@ -3,11 +3,22 @@
 
 #include <algorithm>
 #include <sstream>
+#include <string_view>
+#include <vector>
 
 constexpr unsigned int stringHash(const char *str, const int offset = 0) {
     return !str[offset] ? 5381 : (stringHash(str, offset+1)*33) ^ str[offset];
 }
 
+/// Same hash as above for views that are not null terminated, e.g. fields of a tokenized sentence
+constexpr unsigned int stringHash(const std::string_view str) {
+    unsigned int hash = 5381;
+    for (size_t i = str.size(); i > 0; i--) {
+        hash = (hash * 33) ^ str[i - 1];
+    }
+    return hash;
+}
+
 static std::string getStringFromBuffer(const char* buffer, const size_t startPos, const size_t len){
     std::stringstream ss;
     for(int i = 0; i < len; i++) {
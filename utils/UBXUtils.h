@@ -0,0 +1,142 @@
+#ifndef UBXUTILS_H
+#define UBXUTILS_H
+
+#include <algorithm>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include <boost/endian/conversion.hpp>
+
+static constexpr uint8_t UBX_SYNC_1 = 0xB5;
+static constexpr uint8_t UBX_SYNC_2 = 0x62;
+static constexpr size_t UBX_HEADER_LENGTH = 6;
+static constexpr size_t UBX_MAX_PAYLOAD = 1024;
+
+static constexpr uint8_t UBX_CLASS_NAV = 0x01;
+static constexpr uint8_t UBX_CLASS_ACK = 0x05;
+static constexpr uint8_t UBX_CLASS_CFG = 0x06;
+
+static constexpr uint8_t UBX_NAV_TIMEUTC = 0x21;
+static constexpr uint8_t UBX_NAV_PVT = 0x07;
+static constexpr uint8_t UBX_NAV_SAT = 0x35;
+static constexpr uint8_t UBX_ACK_NAK = 0x00;
+static constexpr uint8_t UBX_ACK_ACK = 0x01;
+static constexpr uint8_t UBX_CFG_VALSET = 0x8A;
+
+//Configuration keys for CFG-VALSET (generation 9 receivers and later)
+static constexpr uint32_t UBX_CFG_RATE_MEAS = 0x30210001;
+static constexpr uint32_t UBX_CFG_MSGOUT_NAV_PVT_UART1 = 0x20910007;
+static constexpr uint32_t UBX_CFG_MSGOUT_NAV_PVT_USB = 0x20910009;
+static constexpr uint32_t UBX_CFG_MSGOUT_NAV_SAT_UART1 = 0x20910016;
+static constexpr uint32_t UBX_CFG_MSGOUT_NAV_SAT_USB = 0x20910018;
+static constexpr uint32_t UBX_CFG_MSGOUT_NAV_TIMEUTC_UART1 = 0x2091005C;
+static constexpr uint32_t UBX_CFG_MSGOUT_NAV_TIMEUTC_USB = 0x2091005E;
+static constexpr uint32_t UBX_CFG_UART1OUTPROT_UBX = 0x10740001;
+static constexpr uint32_t UBX_CFG_UART1OUTPROT_NMEA = 0x10740002;
+static constexpr uint32_t UBX_CFG_USBOUTPROT_UBX = 0x10780001;
+static constexpr uint32_t UBX_CFG_USBOUTPROT_NMEA = 0x10780002;
+
+///
+/// A framed UBX message. payload points into the caller's receive buffer, so a frame is only valid until that buffer is
+/// reused.
+///
+struct UbxFrame {
+    uint8_t msgClass = 0;
+    uint8_t msgId = 0;
+    const uint8_t* payload = nullptr;
+    uint16_t length = 0;
+
+    [[nodiscard]] uint8_t u1(const size_t offset) const { return payload[offset]; }
+    [[nodiscard]] int8_t i1(const size_t offset) const { return static_cast<int8_t>(payload[offset]); }
+    [[nodiscard]] uint16_t u2(const size_t offset) const { return boost::endian::load_little_u16(payload + offset); }
+    [[nodiscard]] int16_t i2(const size_t offset) const { return boost::endian::load_little_s16(payload + offset); }
+    [[nodiscard]] uint32_t u4(const size_t offset) const { return boost::endian::load_little_u32(payload + offset); }
+    [[nodiscard]] int32_t i4(const size_t offset) const { return boost::endian::load_little_s32(payload + offset); }
+};
+
+enum class UbxParseResult {
+    OK = 0,
+    INCOMPLETE,
+    INVALID_START,
+    INVALID_LENGTH,
+    INVALID_CHECKSUM
+};
+
+///
+/// 8-bit Fletcher checksum over class, ID, length and payload as defined by the UBX protocol
+///
+inline void ubxChecksum(const uint8_t* data, const size_t len, uint8_t& ckA, uint8_t& ckB) {
+    ckA = 0;
+    ckB = 0;
+    for (size_t i = 0; i < len; i++) {
+        ckA += data[i];
+        ckB += ckA;
+    }
+}
+
+///
+/// Frames a UBX message at the start of data. On OK consumed is set to the full frame length including sync chars and
+/// checksum. INCOMPLETE means the frame may be valid but more bytes are needed; any other result means data does not
+/// start with a valid frame.
+///
+inline UbxParseResult parseUbxFrame(const std::string_view data, UbxFrame& out, size_t& consumed) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    if (data.size() < 2) {
+        return data.empty() || bytes[0] == UBX_SYNC_1 ? UbxParseResult::INCOMPLETE : UbxParseResult::INVALID_START;
+    }
+    if (bytes[0] != UBX_SYNC_1 || bytes[1] != UBX_SYNC_2) {
+        return UbxParseResult::INVALID_START;
+    }
+    if (data.size() < UBX_HEADER_LENGTH) {
+        return UbxParseResult::INCOMPLETE;
+    }
+    const uint16_t length = boost::endian::load_little_u16(bytes + 4);
+    if (length > UBX_MAX_PAYLOAD) {
+        return UbxParseResult::INVALID_LENGTH;
+    }
+    const size_t frameLength = UBX_HEADER_LENGTH + length + 2;
+    if (data.size() < frameLength) {
+        return UbxParseResult::INCOMPLETE;
+    }
+    uint8_t ckA, ckB;
+    ubxChecksum(bytes + 2, length + 4, ckA, ckB);
+    if (ckA != bytes[frameLength - 2] || ckB != bytes[frameLength - 1]) {
+        return UbxParseResult::INVALID_CHECKSUM;
+    }
+    out.msgClass = bytes[2];
+    out.msgId = bytes[3];
+    out.payload = bytes + UBX_HEADER_LENGTH;
+    out.length = length;
+    consumed = frameLength;
+    return UbxParseResult::OK;
+}
+
+///
+/// Builds a complete UBX frame, sync chars and checksum included, ready to write to the receiver
+///
+inline std::vector<uint8_t> buildUbxFrame(const uint8_t msgClass, const uint8_t msgId, const std::vector<uint8_t>& payload) {
+    std::vector<uint8_t> frame(UBX_HEADER_LENGTH + payload.size() + 2);
+    frame[0] = UBX_SYNC_1;
+    frame[1] = UBX_SYNC_2;
+    frame[2] = msgClass;
+    frame[3] = msgId;
+    boost::endian::store_little_u16(frame.data() + 4, static_cast<uint16_t>(payload.size()));
+    std::ranges::copy(payload, frame.begin() + UBX_HEADER_LENGTH);
+    ubxChecksum(frame.data() + 2, payload.size() + 4, frame[frame.size() - 2], frame[frame.size() - 1]);
+    return frame;
+}
+
+///
+/// Appends a key/value pair to a CFG-VALSET payload. The value width is encoded in bits 28-30 of the key ID.
+///
+inline void appendUbxConfigValue(std::vector<uint8_t>& payload, const uint32_t key, const uint32_t value) {
+    uint8_t buf[4];
+    boost::endian::store_little_u32(buf, key);
+    payload.insert(payload.end(), buf, buf + 4);
+    const uint32_t size = (key >> 28) & 0x07;
+    const size_t width = size == 3 ? 2 : size == 4 ? 4 : 1;
+    boost::endian::store_little_u32(buf, value);
+    payload.insert(payload.end(), buf, buf + width);
+}
+
+#endif //UBXUTILS_H